@@ -4,50 +4,430 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <termios.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdarg.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include "trace.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 /*** defines ***/
 #define CTRL_KEY(k) ((k) & 0x1f)
 #define VERSION "0.0.1"
 #define ABUF_INIT {NULL, 0}
 #define TAB_STOP 8
+#define RXMAP_STRIDE 128 // a row's rxmap holds the render column of every RXMAP_STRIDE-th byte
+#define LONG_ROW_BYTES (64 * 1024) // rows longer than this are stored in chunks and rendered only where they're on screen
+#define ROW_CHUNK_SIZE 4096 // how full chunks are when a long row is cut up
+#define ROW_CHUNK_MAX 8192 // capacity of a chunk (room to type into before it has to be split)
+#define ROW_INLINE_SIZE 24 // rows shorter than this are stored inside their erow
+#define ROW_GAP_MIN 64 // smallest gap the row being edited gets (see editorRowOpenGap())
+#define SLAB_SIZE (64 * 1024) // row contents are carved out of blocks this big
+#define SLAB_MAX 4096 // row contents bigger than this are malloc()ed on their own
+#define SLAB_CLASSES 32 // size classes of row contents up to SLAB_MAX
+#define SLAB_SPARE 16 // released slabs kept for the next arena to use instead of malloc()ing new ones
+#define BLOCK_ROWS 256 // most rows in a leaf of the row tree
+#define NODE_CHILDREN 32 // most children of an inner node of the row tree
+#define WRITE_BUF_SIZE (64 * 1024) // rows are saved this many bytes at a time
+#define VIEW_INDEX_STRIDE 1024 // -R: the start of every VIEW_INDEX_STRIDE-th line is kept
+#define VIEW_WINDOW_ROWS 512 // -R: rows decoded around the one being looked at
+#define FOLLOW_READ_SIZE (64 * 1024) // -f: what's appended to the file is read this many bytes at a time
+#define WATCH_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF) // inotify events that can mean the file changed
+#define RELOAD_MAX_EDITS 1024 // a reload diffs files differing in at most this many lines (see editorReload())
+#define HASH_BASIS 14695981039346656037UL // FNV-1a
+#define HEX_ROW_BYTES 16 // -x: bytes shown on a row
+#define HEX_PAGE_SIZE 4096 // -x: changed bytes are kept (and written back) in pages this big
+#define FRAME_RATE 60 // most frames a second while keys keep coming (-F changes it, 0 for no limit)
+#define SYNC_QUERY_MS 200 // how long to wait for the terminal to say whether it can synchronize output (see editorDetectSync())
+#define SYNC_BEGIN "\x1b[?2026h" // DEC mode 2026: hold drawing until SYNC_END, so a frame never shows half done
+#define SYNC_END "\x1b[?2026l"
+#define KEYS_MAGIC "HEXAKEY1" // -r/-p: start of a file of recorded keys
+#define KEYS_ESCAPE_WAIT_US 100000 // -p: a byte that came this much later wasn't part of the key before it (VTIME in enableRawMode())
+#define TRACE_EVENTS (1 << 16) // HEXA_TRACE: spans kept (the oldest are overwritten)
 #define QUIT_TIMES 1
+#define SAVE_TIMES 1 // extra Ctrl-S presses it takes to save over a file another program changed
 
-// 1000: out of range of char so they don't conflict with normal keypress
+#define HL_BATCH_ROWS 512 // most rows handed to the highlighter thread at once
+#define HL_FRAME_WAIT_MS 4 // how long a frame waits for the highlighter to finish the rows on screen
+
+// past the last Unicode codepoint (0x10FFFF), so they don't conflict with typed characters
 enum editorKey 
 {
     BACKSPACE = 127,
-    ARROW_LEFT = 1000,
-    ARROW_RIGHT = 1001,
-    ARROW_UP = 1002,
-    ARROW_DOWN = 1003,
-    HOME_KEY = 1004,
-    END_KEY = 1005,
-    PAGE_UP = 1006,
-    PAGE_DOWN = 1007,
-    DEL_KEY = 1008
+    ARROW_LEFT = 0x110000,
+    ARROW_RIGHT,
+    ARROW_UP,
+    ARROW_DOWN,
+    HOME_KEY,
+    END_KEY,
+    PAGE_UP,
+    PAGE_DOWN,
+    DEL_KEY,
+    FILE_START, // Ctrl-Home
+    FILE_END, // Ctrl-End
+    TERMINAL_REPLY // an answer to a query of editorDetectSync() that came too late, not a key (editorReadKey() skips it)
+};
+
+// highlight class of each byte in chars
+enum editorHighlight
+{
+    HL_NORMAL = 0,
+    HL_COMMENT,
+    HL_MLCOMMENT,
+    HL_KEYWORD1,
+    HL_KEYWORD2,
+    HL_STRING,
+    HL_NUMBER
+};
+
+// byte classes in the generated syntax tables (see syntax.def and tools/syntaxgen.c)
+enum editorCharClass
+{
+    CC_SEPARATOR = 1 << 0, // whitespace and punctuation that ends a word
+    CC_WORD = 1 << 1, // can be part of a keyword or identifier
+    CC_DIGIT = 1 << 2, // only set when the filetype highlights numbers
+    CC_NUMBER_DOT = 1 << 3, // '.' continuing a number
+    CC_QUOTE = 1 << 4, // only set when the filetype highlights strings
+    CC_COMMENT = 1 << 5, // first byte of a comment start delimiter
+    CC_COMMENT_END = 1 << 6 // first byte of the block comment end delimiter
+};
+
+// lexer state at the end of a row (the state the next row starts in)
+enum editorLexState
+{
+    LEX_NORMAL = 0,
+    LEX_MLCOMMENT
+};
+
+// where the contents of a row live
+enum editorRowStorage
+{
+    ROW_INLINE = 0, // in the erow itself (size < ROW_INLINE_SIZE)
+    ROW_HEAP, // in the buffer's arena
+    ROW_GAP, // in a gap buffer, while the cursor is on the row (see editorRowOpenGap())
+    ROW_CHUNKED // in chunks (size > LONG_ROW_BYTES, see editorRowMakeChunked())
+};
+
+// 2 bit display width classes in the generated width table (see tools/wcwidthgen.c)
+enum editorWidthClass
+{
+    WC_ZERO = 0, // combining marks and other zero width characters
+    WC_NARROW = 1,
+    WC_WIDE = 2, // CJK, emoji, ... (2 columns)
+    WC_NONPRINT = 3 // control characters, unassigned codepoints, surrogates (shown as an inverted '?', 1 column)
 };
 
 
 /*** data ***/
+// piece of a long row
+typedef struct rowchunk 
+{
+    char* data; // ROW_CHUNK_MAX bytes
+    int len;
+    long cx; // index of the chunk's first byte in the row (chunks always start at a character boundary)
+    long rx; // render column the chunk starts at
+    int has_tab;
+    int ascii; // only 1 column wide characters, no tabs
+    int lead; // render width of the characters before the first tab (of all of them if there's no tab)
+    int tail; // render width of the characters after the first tab, counted from the tab stop it ends on
+} rowchunk;
+
+// block of memory row contents are carved out of
+struct slab
+{
+    struct slab* next;
+    char data[]; // SLAB_SIZE bytes
+};
+
+// where a buffer's row contents live (see editorArenaAlloc())
+struct rowArena
+{
+    struct slab* slabs; // every slab, so they can all be released at once
+    char* bump; // free space left at the end of the newest slab
+    char* bump_end;
+    char* free[SLAB_CLASSES]; // freed pieces of each size class, linked through their first bytes
+};
+
+// slot in a generated keyword table (empty slots have len 0)
+struct hlKeyword 
+{
+    const char* word;
+    int len;
+    int hl; // HL_KEYWORD1 or HL_KEYWORD2
+};
+
+// rules for one filetype, generated from syntax.def at build time
+struct editorSyntax 
+{
+    char* filetype;
+    char** filematch; // patterns to match filename against (starting with '.' means file extension)
+    const unsigned char* classes; // enum editorCharClass bits of every byte
+    const struct hlKeyword* keywords; // perfect hash table: a keyword can only be in slot editorKeywordHash() & keyword_mask
+    unsigned int keyword_seed;
+    unsigned int keyword_mask; // table size - 1 (table size is a power of 2)
+    int keyword_minlen, keyword_maxlen; // words outside this range can't be keywords, so they're not even hashed
+    char* singleline_comment_start;
+    char* multiline_comment_start;
+    char* multiline_comment_end;
+    int scs_len, mcs_len, mce_len;
+};
+
 // editor row (for storage)
 typedef struct erow 
 {
-    int size;
-    int rsize; // size of contents of render
-    char* chars;
-    char* render;
+    long size; // in bytes
+    long rsize; // width of the row on screen, in columns
+    union
+    {
+        char small[ROW_INLINE_SIZE]; // ROW_INLINE: the contents themselves (NUL terminated), no allocation at all
+        struct
+        {
+            char* chars; // UTF-8 text (bytes that aren't valid UTF-8 are kept as they are)
+            int* rxmap; // cx -> rx checkpoints for rows that aren't ascii, built on first use (NULL until then, fits in an int: the row is short)
+        } heap; // ROW_HEAP
+        struct
+        {
+            char* buf; // contents are buf[0, gap) followed by buf[gap + gap_len, size + gap_len), then a NUL
+            int gap; // a row is never longer than LONG_ROW_BYTES while it has a gap
+            int gap_len;
+        } gap; // ROW_GAP
+        struct
+        {
+            rowchunk* chunks;
+            int numchunks;
+        } chunked; // ROW_CHUNKED: a long row
+    } u; // the contents, depending on storage (editorRowSegment() and editorRowCopy() work for all of them)
+    unsigned long version; // changes every time the row is updated (never reused)
+    unsigned char* hl; // highlight of each byte in chars (only matches chars when hl_current is set)
+    unsigned char storage; // enum editorRowStorage
+    unsigned char ascii; // every character is 1 column wide (no tabs, no multibyte or control characters), so rx == cx
+    unsigned char hl_state; // lexer state at the end of this row (enum editorLexState)
+    unsigned char hl_dirty; // row changed (or the row before it did) since it was last highlighted for real
+    unsigned char hl_current; // hl was computed for the row as it is now (cleared by every update)
 } erow;
 
+// a node of the row tree (see editorRow())
+struct rowNode
+{
+    struct rowNode* parent; // NULL for the root
+    int leaf; // leaves hold rows, inner nodes hold other nodes
+    int count; // rows (leaf) or children (inner node) in use
+    long numrows; // rows in this subtree
+    long numbytes; // bytes in this subtree, counting the newline after every row (see editorTreeSettle())
+    erow* rows; // leaf: room for BLOCK_ROWS
+    struct rowNode** children; // inner node: room for NODE_CHILDREN
+};
+
+// a file mapped for viewing (-R) instead of read into the row tree (see editorViewOpen())
+struct fileView
+{
+    char* map; // the whole file (NULL if it's empty)
+    long size;
+    long* index; // index[k]: where line k * VIEW_INDEX_STRIDE starts
+    long numindex, indexcap;
+    long scanned; // where line 'lines' starts: everything before it has been searched for newlines
+    long lines; // lines found so far
+    erow* window; // decoded rows (room for VIEW_WINDOW_ROWS)
+    long window_first; // index of the first row in window
+    int window_count;
+};
+
+// a row copied for the highlighter thread, and the result it produces
+struct hlRow 
+{
+    long at; // index of the row when it was copied
+    unsigned long version;
+    char* chars;
+    int size; // long rows aren't highlighted, so this is small
+    unsigned char* hl; // set by the worker
+    int state_in, state_out; // set by the worker
+};
+
+struct hlBatch 
+{
+    struct editorSyntax* syntax;
+    int state; // lexer state the first row starts in
+    int numrows;
+    struct hlRow* rows;
+    int visible; // batch contains rows on screen
+    int installed; // rows picked up by the main thread (main thread only)
+    int done; // rows highlighted so far (written by the worker, atomic)
+    int finished; // worker is done with this batch (atomic)
+    int cancel; // asks the worker to stop early (atomic)
+};
+
+// state shared with the highlighter thread
+struct editorHighlighter 
+{
+    pthread_mutex_t lock; // protects pending
+    pthread_cond_t wake;
+    struct hlBatch* pending; // batch waiting to be picked up by the worker
+    struct hlBatch* inflight; // batch the worker owns results for (main thread only)
+    int pipe[2]; // the worker writes a byte here after every batch
+    int failed; // the worker couldn't write to the pipe and is gone (atomic)
+};
+
+// a page of a file in hex mode that has been changed (a copy of it out of the map)
+struct hexPage
+{
+    long page; // index of the page in the file
+    unsigned char* data; // HEX_PAGE_SIZE bytes
+};
+
+// -x: a file shown and edited as bytes (see editorHexOpen())
+struct editorHex
+{
+    int fd;
+    int writable; // opened for writing, so bytes can be changed
+    unsigned char* map; // the whole file (NULL if it's empty)
+    long size;
+    struct hexPage* pages; // changed pages, sorted by page
+    int numpages, pagecap;
+    int digits; // how many hex digits offsets are shown with
+    int nibble; // the cursor is on the low 4 bits of its byte (the next hex digit typed goes there)
+};
+
+// the file being edited, and what it looked like when it was last read or written (see editorWatchPoll())
+struct editorWatch
+{
+    int inotify; // inotify instance watching the file (-1 if none)
+    int wd; // the watch on the file (-1 if none)
+    int fd; // -f: the file, kept open to read what's appended to it
+    dev_t dev;
+    ino_t ino; // 0 if there's nothing to compare with
+    long size;
+    struct timespec mtime;
+    long offset; // -f: how much of the file has been read into rows
+    int partial; // -f: the last row had no newline after it yet, so what's appended next goes on the end of it
+};
+
+// frame timings, shown in the message bar while the overlay is on (Ctrl-T); times are in seconds
+struct editorStats
+{
+    int on;
+    double key_time; // when the key that hasn't been painted yet came in (0: none)
+    double latency; // from a key coming in to the screen it changed being written out
+    double scroll, rows, write; // editorScroll(), editorDrawRows() and write() of the last frame
+    int bytes; // written for the last frame
+    double fps;
+    long frames; // drawn since fps_time
+    double fps_time;
+};
+
+// bytes of memory the buffer takes up, by what they're for (see editorMemoryUsage())
+struct editorMemory
+{
+    long nodes; // the row tree: erows in the leaves, child pointers in inner nodes
+    long text; // row contents: arena slabs, big rows, gap buffers, chunks
+    long hl; // highlight of rows
+    long rxmap; // render column checkpoints of rows
+    long view; // -R: line index and decoded rows (not the map, that's the page cache)
+    long hex; // -x: changed pages
+    long total;
+    long frame_peak; // the biggest frame built so far (an abuf, freed after every frame: it's not in total)
+};
+
+// -r/-p: a byte of input, and how long after the one before it it came (the file is KEYS_MAGIC, then these)
+struct keyRecord
+{
+    uint32_t delay; // in us
+    unsigned char byte;
+    unsigned char unused[3];
+};
+
+// -r: record the input, -p: play recorded input back (with the same timing) instead of reading the terminal
+struct editorKeys
+{
+    int record; // file the input is recorded to (-1 if none)
+    double last; // when the last byte was recorded
+    struct keyRecord* replay; // recorded input being played back
+    long count;
+    long pos; // next to play back (count: done, the terminal takes over)
+    double due; // when replay[pos] comes in
+};
+
+// HEXA_TRACE=path: spans are written to a ring buffer in the file (see trace.h), tools/trace2json turns it into a Chrome trace
+struct editorTrace
+{
+    struct traceHeader* header; // NULL: not tracing
+    struct traceEvent* events;
+};
+
+// running without a terminal (for benchmarks, see tools/bench.c): keys come from a script, and output is only counted
+struct editorHeadless
+{
+    int on;
+    int rows, cols; // size of the terminal it pretends to draw on
+    const char* keys; // the script: bytes just as a terminal would send them
+    const char* late; // bytes of keys that came too late to be part of the key before them (from a recording), or NULL
+    long len;
+    long pos; // next byte of keys to read
+    long bytes; // output that would have gone to the terminal
+    long frames; // screens drawn
+};
+
+// keys typed while editorDetectSync() waited for the terminal's answers, read before anything new
+struct editorTypeahead
+{
+    char buf[256];
+    int len;
+    int pos; // next byte of buf to read
+};
+
+// what the terminal shows, as of the last frame (see editorDrawRows())
+struct editorScreen
+{
+    unsigned long* lines; // hash of every text line drawn (0: unknown, it has to be drawn)
+    int rows, cols; // size of the screen they were drawn on
+    long rowoff; // row of the file at the top
+};
+
+// an open file: its rows (or -R view, or -x bytes), how it's opened, and where it's being looked at
+struct editorBuffer
+{
+    char* filename;
+    struct editorSyntax* syntax; // NULL when there's no filetype for the file
+    int readonly; // -R: files are mapped and viewed, not read into rows (see editorViewOpen())
+    int follow; // -f: keep reading what's appended to the file, like tail -f
+    int hexmode; // -x: files are shown and edited as bytes (see editorHexOpen())
+    long numrows;
+    struct rowNode* rows; // root of the row tree, NULL while there are no rows (use editorRow() to get at a row)
+    struct rowNode* row_leaf; // leaf editorRow() found last, so runs of nearby rows don't walk the tree again
+    long row_leaf_first; // index of the first row in row_leaf
+    struct rowNode* stale_leaf; // leaf whose byte count hasn't caught up with its rows yet (see editorTreeSettle())
+    struct rowArena arena; // contents of the rows
+    long gap_row; // row that has a gap buffer open (-1 if none)
+    int* gap_rxmap; // rxmap checkpoints of the text before that row's gap (see editorRowGapRx())
+    int gap_rxmap_len; // how many of them are filled in
+    int dirty; // keep track of whether the text loaded in the editor differs from what’s in the file
+    long hl_frontier; // every row above this index has an up to date highlight
+    struct fileView view;
+    struct editorHex hex;
+    struct editorWatch watch;
+    // the view of the buffer: it stays with it, so going back to a buffer shows the screen it was left at
+    long cx, cy;
+    long rx; // horizontal coordinate (screen column, as oppose to cx which is a byte index into the chars field of erow)
+    long rowoff; // vertical scroll offset
+    long coloff; // horizontal scroll offset
+};
+
 // append buffer
 struct abuf 
 {
@@ -56,35 +436,81 @@ struct abuf
 };
 struct editorConfig 
 {
-    int cx, cy;
-    int rx; // horizontal coordinate (index of render field as oppose to cx which is index of the chars field of erow)
-    int rowoff; // vertical scroll offset
-    int coloff; // horizontal scroll offset
+    struct editorBuffer* buf; // the buffer being edited, buffers[current]
+    struct editorBuffer** buffers; // every open file, in the order they were opened
+    int numbuffers, buffercap;
+    int current;
+    int open_readonly, open_follow, open_hexmode; // -R, -f, -x: how files are opened
     int screenrows;
     int screencols;
-    int numrows;
-    erow* row; // array for storing multiple lines
-    int dirty; // keep track of whether the text loaded in the editor differs from what’s in the file
-    char* filename;
+    struct editorHeadless headless;
+    struct editorStats stats;
+    struct editorTrace trace;
+    struct editorKeys keys;
+    double frame_interval; // least time between frames while keys keep coming (see editorProcessInput())
+    double frame_time; // when the last frame was written
+    struct editorScreen screen;
+    int sync; // the terminal synchronizes output (frames are wrapped in SYNC_BEGIN and SYNC_END)
+    struct editorTypeahead typeahead;
+    long frame_peak; // size of the biggest frame built (for editorMemoryUsage())
+    unsigned long version_clock; // source of erow versions
     char statusmsg[80];
     time_t statusmsg_time; // contain the timestamp when we set a status message 
+    struct editorHighlighter highlighter;
+    struct slab* spare_slabs; // slabs released by any buffer's arena, for the next one (see editorArenaRelease())
+    int numspare;
     struct termios orig_termios;
 };
 
 struct editorConfig E;
 
 
+/*** filetypes ***/
+// highlight database (HLDB), generated from syntax.def by tools/syntaxgen
+#include "syntax.h"
+
+#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+
+
 /*** function prototypes ***/
 void editorSetStatusMessage(const char* fmt, ...);
 void editorRefreshScreen();
+int editorSyntaxPoll();
 char* editorPrompt(char* prompt);
+int editorDecodeChar(const char* s, int len, int* cp);
+void editorRowCopy(erow* row, long at, long len, char* dst);
+erow* editorRow(long at);
+erow* editorViewRow(long at);
+int editorWatchPoll();
+int editorBufferWatchPoll(struct editorBuffer* b);
+double editorNow();
+uint64_t editorTraceBegin();
+int editorDecodeKey(char c);
+int editorKeysPlay(char* c);
+int editorWriteAll(int fd, const char* buf, long len);
+void editorKeysRecord(char c);
+void editorTraceEnd(int span, uint64_t start);
+void editorWatchStart(char* filename, struct stat* st, long offset, int partial);
+long editorViewRowAtOffset(long offset, long* start);
+void editorRowForgetGapRx();
+void editorHexOpen(char* filename);
+void editorHexClose();
+void editorHexSeek(long offset);
 
 /*** terminal ***/
+// monotonic clock, in seconds (for timing frames)
+double editorNow()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
 // error handling (print out error if function returns -1)
 void die(const char* s)
 {
-    write(STDOUT_FILENO, "\x1b[2J", 4);
-    write(STDOUT_FILENO, "\x1b[H", 3); // position the cursor
+    editorWriteAll(STDOUT_FILENO, "\x1b[2J\x1b[H", 7); // clear the screen and position the cursor
 
     perror(s);
     exit(1);
@@ -124,29 +550,182 @@ void enableRawMode()
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) die("tcsetattr");
 }
 
-// wait for 1 keypress, then return it. deals with low-level terminal input
+// block until there's input to read, redrawing the screen whenever the highlighter thread has new results in the meantime
+void editorWaitForInput()
+{
+    if (E.headless.on) return; // the keys are all there already
+    int replaying = (E.keys.pos < E.keys.count);
+    if (!replaying && E.typeahead.pos < E.typeahead.len) return;
+
+    // the terminal, the highlighter, and the watch on the file of every buffer
+    int nfds = 2 + E.numbuffers;
+    struct pollfd* fds = malloc(sizeof(struct pollfd) * nfds);
+    int i, ready = 0;
+
+    if (fds == NULL) die("malloc");
+    fds[0] = (struct pollfd){ replaying ? -1 : STDIN_FILENO, POLLIN, 0 }; // -p: what's typed while the recording plays is left for after it
+    fds[1] = (struct pollfd){ E.highlighter.pipe[0], POLLIN, 0 };
+
+    while (!ready)
+    {
+        // (a reload starts watching afresh, and -1 is ignored by poll() if there's no file)
+        for (i = 0; i < E.numbuffers; i++) fds[2 + i] = (struct pollfd){ E.buffers[i]->watch.inotify, POLLIN, 0 };
+
+        int timeout = -1;
+        if (replaying)
+        {
+            double wait = E.keys.due - editorNow();
+            if (wait <= 0) break;
+            timeout = wait * 1000 + 1;
+        }
+
+        if (poll(fds, nfds, timeout) == -1)
+        {
+            if (errno == EINTR) continue;
+            die("poll");
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            if (editorSyntaxPoll()) editorRefreshScreen();
+        }
+
+        for (i = 0; i < E.numbuffers; i++)
+        {
+            if ((fds[2 + i].revents & POLLIN) && editorBufferWatchPoll(E.buffers[i])) editorRefreshScreen();
+        }
+
+        ready = (fds[0].revents != 0);
+    }
+
+    free(fds);
+}
+
+// read a byte of input from the terminal (or from the script when headless), returns what read() would
+int editorReadByte(char* c)
+{
+    int nread;
+
+    if (E.headless.on)
+    {
+        if (E.headless.pos == E.headless.len) return 0;
+
+        *c = E.headless.keys[E.headless.pos++];
+        return 1;
+    }
+
+    if (E.keys.pos < E.keys.count)
+    {
+        nread = editorKeysPlay(c);
+    }
+    else if (E.typeahead.pos < E.typeahead.len)
+    {
+        *c = E.typeahead.buf[E.typeahead.pos++];
+        nread = 1;
+    }
+    else
+    {
+        nread = read(STDIN_FILENO, c, 1);
+    }
+
+    if (nread == 1 && E.keys.record != -1) editorKeysRecord(*c);
+    return nread;
+}
+
+// read the next byte of a key that has begun (it's not there if it came later than a read() in raw mode waits)
+int editorReadNext(char* c)
+{
+    if (E.headless.on && E.headless.late && E.headless.pos < E.headless.len && E.headless.late[E.headless.pos]) return 0;
+    if (!E.headless.on && E.keys.pos < E.keys.count && E.keys.replay[E.keys.pos].delay >= KEYS_ESCAPE_WAIT_US) return 0;
+
+    return editorReadByte(c);
+}
+
+// wait for 1 keypress, then return it (a Unicode codepoint, or one of editorKey). deals with low-level terminal input
 int editorReadKey()
 {
     int nread;
+    int key;
     char c;
-    
-    while ((nread = read(STDIN_FILENO, &c, 1)) != 1) 
+
+    do
     {
-        if (nread == -1 && errno != EAGAIN) die("read");
-    }
+        while (1)
+        {
+            editorWaitForInput();
+
+            if ((nread = editorReadByte(&c)) == 1) break;
+            if (E.headless.on) return '\x1b'; // the script ran out: whatever is waiting for more keys (a prompt) is cancelled
+            if (nread == -1 && errno != EAGAIN) die("read");
+        }
+
+        if (E.stats.on && E.stats.key_time == 0) E.stats.key_time = editorNow();
 
+        uint64_t t = editorTraceBegin();
+        key = editorDecodeKey(c);
+
+        editorTraceEnd(TRACE_READ_KEY, t);
+    } while (key == TERMINAL_REPLY);
+
+    return key;
+}
+
+// the key that starts with byte c (the rest of an escape sequence or UTF-8 character is read)
+int editorDecodeKey(char c)
+{
     if (c == '\x1b')
     {
         char seq[3];
 
-        if (read(STDIN_FILENO, &seq[0], 1) != 1) return '\x1b';
-        if (read(STDIN_FILENO, &seq[1], 1) != 1) return '\x1b';
+        if (editorReadNext(&seq[0]) != 1) return '\x1b';
+        if (editorReadNext(&seq[1]) != 1) return '\x1b';
         
         if (seq[0] == '[')
         {
+            // "\x1b[?...c" (DA1) or "\x1b[?...$y" (DECRQM): the terminal answering editorDetectSync() after it stopped waiting
+            if (seq[1] == '?')
+            {
+                char b;
+
+                while (editorReadNext(&b) == 1)
+                {
+                    if (b == 'c' || b == 'y') return TERMINAL_REPLY;
+                    if (!isdigit((unsigned char)b) && b != ';' && b != '$') break;
+                }
+                return '\x1b';
+            }
+
             if (seq[1] >= '0' && seq[1] <= '9') 
             {
-                if (read(STDIN_FILENO, &seq[2], 1) != 1) return '\x1b';
+                if (editorReadNext(&seq[2]) != 1) return '\x1b';
+
+                // with a modifier: "\x1b[1;5H" is Ctrl-Home, "\x1b[1;5F" Ctrl-End (the other modifiers are taken as plain keys).
+                // The modifier is 1 plus a bit each for Shift, Alt, Ctrl and Meta, so it can take two digits
+                if (seq[1] == '1' && seq[2] == ';')
+                {
+                    int mod = 0;
+                    char b;
+
+                    while (1)
+                    {
+                        if (editorReadNext(&b) != 1) return '\x1b';
+                        if (!isdigit((unsigned char)b)) break;
+                        mod = mod * 10 + (b - '0');
+                    }
+
+                    int ctrl = (mod > 0 && ((mod - 1) & 4));
+
+                    switch (b)
+                    {
+                        case 'H': return ctrl ? FILE_START : HOME_KEY;
+                        case 'F': return ctrl ? FILE_END : END_KEY;
+                        case 'A': return ARROW_UP;
+                        case 'B': return ARROW_DOWN;
+                        case 'C': return ARROW_RIGHT;
+                        case 'D': return ARROW_LEFT;
+                    }
+                    return '\x1b';
+                }
 
                 if (seq[2] == '~') 
                 {
@@ -187,6 +766,21 @@ int editorReadKey()
 
         return '\x1b';
     }
+    else if ((unsigned char)c >= 0x80)
+    {
+        // first byte of a UTF-8 character, the rest of it follows right away
+        unsigned char u = c;
+        int need = (u >= 0xF0) ? 4 : (u >= 0xE0) ? 3 : (u >= 0xC0) ? 2 : 1;
+        char buf[4];
+        int len = 1;
+        int cp;
+
+        buf[0] = c;
+        while (len < need && editorReadNext(&buf[len]) == 1) len++;
+
+        if (editorDecodeChar(buf, len, &cp) != len || cp < 0) return 0xFFFD; // replacement character
+        return cp;
+    }
     else
     {
         return c;
@@ -234,6 +828,85 @@ int getWindowSize(int* rows, int* cols)
     }
 }
 
+// length of the terminal's answer at s: "\x1b[?" then digits and ';', then 'c' (DA1) or "$y" (DECRQM).
+// 0 if it isn't one, -1 if it may be one that isn't all there yet
+int editorReplyLength(const char* s, int len)
+{
+    int i = 3;
+
+    if (len < 3) return memcmp(s, "\x1b[?", len) ? 0 : -1;
+    if (memcmp(s, "\x1b[?", 3)) return 0;
+
+    while (i < len && (isdigit((unsigned char)s[i]) || s[i] == ';')) i++;
+
+    if (i == len) return -1;
+    if (s[i] == 'c') return i + 1;
+    if (s[i] == '$') return (i + 1 == len) ? -1 : (s[i + 1] == 'y') ? i + 2 : 0;
+    return 0;
+}
+
+/*
+  Ask the terminal whether it knows synchronized output (DECRQM for DEC mode 2026): it answers "\x1b[?2026;Ns$y",
+  where N is 1 or 2 when it does (set or reset right now) and 0 or 4 when it doesn't. Terminals that don't know DECRQM
+  don't answer at all, so a primary device attributes query (DA1, which every terminal answers) goes after it:
+  once the DA1 answer ("\x1b[?...c") is in, there's nothing more to wait for.
+  Whatever else comes in meanwhile was typed: it's kept in E.typeahead to be read as keys. Answers that come after
+  SYNC_QUERY_MS are dropped by editorDecodeKey() when they turn up. One that's halfway in by then gets another
+  SYNC_QUERY_MS to finish, and what's in of it is dropped if it still hasn't (it's not keys either).
+*/
+void editorDetectSync()
+{
+    char* buf = E.typeahead.buf; // what comes in besides the answers is typed, and stays there to be read
+    char in[sizeof(E.typeahead.buf)];
+    int len = 0, done = 0, partial = 0, extended = 0;
+    int i, n;
+    double end = editorNow() + SYNC_QUERY_MS / 1e3;
+
+    if (editorWriteAll(STDOUT_FILENO, "\x1b[?2026$p\x1b[c", 12) == -1) return;
+
+    while (!done && len < (int)sizeof(in))
+    {
+        struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+        int left = (end - editorNow()) * 1000;
+
+        // an answer that's halfway in is worth waiting a bit longer for: the rest of it would be read as keys
+        if (left <= 0 && partial && !extended)
+        {
+            end = editorNow() + SYNC_QUERY_MS / 1e3;
+            left = SYNC_QUERY_MS;
+            extended = 1;
+        }
+
+        if (left <= 0 || (n = poll(&fd, 1, left)) == -1) break;
+        if (n == 0) continue; // time's up (checked above)
+
+        n = read(STDIN_FILENO, &in[len], sizeof(in) - len);
+        if (n <= 0) break;
+        len += n;
+
+        // the DA1 answer comes last
+        for (i = 0, partial = 0; i < len; i += (n > 0) ? n : 1)
+        {
+            n = editorReplyLength(&in[i], len - i);
+            if (n > 0 && in[i + n - 1] == 'c') done = 1;
+            if (n == -1 && len - i >= 2) partial = 1;
+        }
+    }
+
+    E.typeahead.len = E.typeahead.pos = 0;
+    for (i = 0; i < len; i += (n > 0) ? n : 1)
+    {
+        n = editorReplyLength(&in[i], len - i);
+
+        if (n > 9 && !memcmp(&in[i], "\x1b[?2026;", 8))
+            E.sync = (in[i + 8] == '1' || in[i + 8] == '2') && in[i + 9] == '$';
+        else if (n == -1 && len - i >= 2)
+            break; // an answer that was still coming in: its first bytes aren't keys either (a lone ESC at the end is, though)
+        else if (n <= 0)
+            buf[E.typeahead.len++] = in[i];
+    }
+}
+
 void abAppend(struct abuf *ab, const char *s, int len) 
 {
     char* new = realloc(ab->b, ab->len + len);
@@ -250,158 +923,3485 @@ void abFree(struct abuf* ab)
     free(ab->b);
 }
 
-/*** row operations (no worries about where the cursor is) ***/
-// converts a chars index into a render index (looping through all the characters to the left of cx, and figure out how many spaces each tab takes up)
-// use rx % TAB_STOP to find out how many columns we are to the right of the last tab stop
-// then subtract that from TAB_STOP - 1 to find out how many columns we are to the left of the next tab stop
-// add that amount to rx to get just to the left of the next tab stop, and then the unconditional rx++ statement gets us right on the next tab stop
-int editorRowCxToRx(erow* row, int cx) // basically a function for working with lines with tabs in them
+/*** recorded keys ***/
+// -r: record what's typed (with timing) to path. Returns -1 (errno set) if it can't
+int editorKeysRecordTo(const char* path)
 {
-    int rx = 0;
-    int j;
-
-    for (j = 0; j < cx; j++) 
+    E.keys.record = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (E.keys.record == -1) return -1;
+    if (write(E.keys.record, KEYS_MAGIC, 8) != 8)
     {
-        if (row->chars[j] == '\t')
-            rx += (TAB_STOP - 1) - (rx % TAB_STOP);
-        rx++;
+        close(E.keys.record);
+        E.keys.record = -1;
+        return -1;
     }
 
-    return rx;
+    E.keys.last = editorNow();
+    return 0;
 }
 
-void editorUpdateRow(erow* row)
+// written as it's typed, so a session that crashes or hangs is recorded up to there
+void editorKeysRecord(char c)
 {
-    int tabs = 0;
-    int j;
-    int idx = 0;
+    double now = editorNow();
+    double delay = (now - E.keys.last) * 1e6;
+    struct keyRecord k = { delay > UINT32_MAX ? UINT32_MAX : (uint32_t)delay, (unsigned char)c, { 0 } };
 
-    for (j = 0; j < row->size; j++)
-        if (row->chars[j] == '\t') tabs++;
-  
-    free(row->render);
-    row->render = malloc(row->size + tabs * (TAB_STOP - 1) + 1);
-    
-    for (j = 0; j < row->size; j++) 
+    E.keys.last = now;
+    if (write(E.keys.record, &k, sizeof(k)) != sizeof(k)) die("write");
+}
+
+// -p: load keys recorded with -r, to play back (or for tools/bench to take them). Returns -1 (errno set) if it can't
+// (these two run before raw mode is on, so they leave reporting errors to the caller rather than die(), which clears the screen)
+int editorKeysLoad(const char* path)
+{
+    FILE* fp = fopen(path, "r");
+    char magic[8];
+    struct keyRecord k;
+
+    if (fp == NULL) return -1;
+    if (fread(magic, 8, 1, fp) != 1 || memcmp(magic, KEYS_MAGIC, 8))
     {
-        if (row->chars[j] == '\t') 
-        {
-            row->render[idx++] = ' ';
-            while (idx % TAB_STOP != 0) row->render[idx++] = ' ';
-        } 
-        else
+        fclose(fp);
+        errno = EINVAL; // not a recording
+        return -1;
+    }
+
+    free(E.keys.replay);
+    E.keys.replay = NULL;
+    E.keys.count = 0;
+
+    long cap = 0;
+    while (fread(&k, sizeof(k), 1, fp) == 1)
+    {
+        if (E.keys.count == cap)
         {
-            row->render[idx++] = row->chars[j];
+            cap = cap ? cap * 2 : 1024;
+            E.keys.replay = realloc(E.keys.replay, cap * sizeof(struct keyRecord));
+            if (E.keys.replay == NULL)
+            {
+                fclose(fp);
+                E.keys.count = 0;
+                errno = ENOMEM;
+                return -1;
+            }
         }
+        E.keys.replay[E.keys.count++] = k;
     }
-  
-    row->render[idx] = '\0';
-    row->rsize = idx;
+    fclose(fp);
+
+    E.keys.pos = 0;
+    if (E.keys.count) E.keys.due = editorNow() + E.keys.replay[0].delay / 1e6;
+    return 0;
 }
 
-// First validate 'at', then allocate memory for one more erow, and use memmove() to make room at the specified index for the new row.
-void editorInsertRow(int at, char* s, size_t len)
+// the next recorded byte (editorWaitForInput() waits until the first byte of a key is due, the rest come with it)
+int editorKeysPlay(char* c)
 {
-    if (at < 0 || at > E.numrows) return;
+    *c = E.keys.replay[E.keys.pos].byte;
+    E.keys.pos++;
+    if (E.keys.pos < E.keys.count) E.keys.due = editorNow() + E.keys.replay[E.keys.pos].delay / 1e6;
+    else editorSetStatusMessage("Replay done");
 
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
+    return 1;
+}
 
-    // int at = E.numrows; // set to index of new row to initialize
 
-    E.row[at].size = len;
-    E.row[at].chars = malloc(len + 1);
+/*** tracing ***/
+// HEXA_TRACE=path: start tracing to path (see struct editorTrace)
+void editorTraceOpen(const char* path)
+{
+    size_t size = sizeof(struct traceHeader) + TRACE_EVENTS * sizeof(struct traceEvent);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
 
-    memcpy(E.row[at].chars, s, len);
-    E.row[at].chars[len] = '\0';
+    if (fd == -1 || ftruncate(fd, size) == -1) die(path);
 
-    E.row[at].rsize = 0;
-    E.row[at].render = NULL;
-    editorUpdateRow(&E.row[at]);
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) die("mmap");
 
-    E.numrows++;
-    E.dirty++;
+    E.trace.header = map;
+    E.trace.events = (struct traceEvent*)(E.trace.header + 1);
+    E.trace.header->capacity = TRACE_EVENTS;
+    E.trace.header->next = 0;
+    memcpy(E.trace.header->magic, TRACE_MAGIC, sizeof(E.trace.header->magic));
 }
 
-// free memory owned by the erow being deleted 
-/*
-  First we validate the at index. 
-  Then we free the memory owned by the row using editorFreeRow(). 
-  We then use memmove() to overwrite the deleted row struct with the rest of the rows that come after it, and decrement numrows.
-*/
-void editorFreeRow(erow* row)
+// start of a span (0 when not tracing, which editorTraceEnd() ignores)
+uint64_t editorTraceBegin()
 {
-    free(row->render);
-    free(row->chars);
-}
+    struct timespec t;
 
-void editorDelRow(int at) 
-{
-    if (at < 0 || at >= E.numrows) return;
-    editorFreeRow(&E.row[at]);
-    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
+    if (E.trace.header == NULL) return 0;
 
-    E.numrows--;
-    E.dirty++;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
 }
 
-// inserts a single character into an erow at a given position
-void editorRowInsertChar(erow* row, int at, int c) 
+// a span that started at 'start' ends now (main thread only: the ring isn't locked)
+void editorTraceEnd(int span, uint64_t start)
 {
-    if (at < 0 || at > row->size) at = row->size;
-    row->chars = realloc(row->chars, row->size + 2);
+    if (start == 0) return;
 
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
+    uint64_t end = editorTraceBegin();
+    struct traceEvent* ev = &E.trace.events[E.trace.header->next % E.trace.header->capacity];
 
-    row->size++;
-    row->chars[at] = c;
-    
-    editorUpdateRow(row);
-    E.dirty++;
+    ev->start = start;
+    ev->duration = (end - start > UINT32_MAX) ? UINT32_MAX : end - start;
+    ev->span = span;
+    ev->unused = 0;
+    E.trace.header->next++;
 }
 
-// appends string to the end of a row
+
+/*** unicode ***/
 /*
-  The row’s new size is row->size + len + 1 (including the null byte), so first we allocate that much memory for row->chars.
-  Then we simply memcpy() the given string to the end of the contents of row->chars.
-  We update row->size, call editorUpdateRow() as usual
+  Rows hold the bytes of the file as they are, which is UTF-8 text (most of the time).
+  cx is a byte index that always sits at the start of a character, rx is a screen column.
+  Bytes that aren't part of a valid UTF-8 sequence count as characters of their own (1 column wide, drawn as an inverted '?'),
+  so a file that isn't UTF-8 can still be opened, edited and saved without losing a single byte.
 */
-void editorRowAppendString(erow* row, char* s, size_t len)
-{
-    row->chars = realloc(row->chars, row->size + len + 1);
-    memcpy(&row->chars[row->size], s, len);
-    row->size += len;
-    row->chars[row->size] = '\0';
-    editorUpdateRow(row);
-    E.dirty++;
-}
 
-// use memmove() to overwrite the deleted character with the characters that come after it
-void editorRowDelChar(erow* row, int at)
+// display width classes of every codepoint, generated from the C library's wcwidth() by tools/wcwidthgen
+#include "wcwidth.h"
+
+// decode the character at s (at most len bytes), returns how many bytes it takes. *cp is -1 if it isn't valid UTF-8 (1 byte then)
+int editorDecodeChar(const char* s, int len, int* cp)
 {
-    if (at < 0 || at >= row->size) return;
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
+    const unsigned char* u = (const unsigned char*)s;
+    int n, c, i;
 
-    row->size--;
+    if (u[0] < 0x80)
+    {
+        *cp = u[0];
+        return 1;
+    }
 
-    editorUpdateRow(row);
-    E.dirty++;
-}
+    if (u[0] >= 0xC2 && u[0] <= 0xDF) { n = 2; c = u[0] & 0x1F; }
+    else if (u[0] >= 0xE0 && u[0] <= 0xEF) { n = 3; c = u[0] & 0x0F; }
+    else if (u[0] >= 0xF0 && u[0] <= 0xF4) { n = 4; c = u[0] & 0x07; }
+    else n = 0; // continuation byte, or a lead byte that can only start an overlong/out of range sequence
 
+    if (n == 0 || n > len)
+    {
+        *cp = -1;
+        return 1;
+    }
 
-/*** editor operations (no worries about details of modifying an erow) ***/
-/*
-  If E.cy == E.numrows, then the cursor is on the tilde line after the end of the file,
-  so we need to append a new row to the file before inserting a character there.
+    for (i = 1; i < n; i++)
+    {
+        if ((u[i] & 0xC0) != 0x80)
+        {
+            *cp = -1;
+            return 1;
+        }
+        c = (c << 6) | (u[i] & 0x3F);
+    }
+
+    // overlong encodings, surrogates and anything past U+10FFFF
+    if ((n == 3 && c < 0x800) || (n == 4 && (c < 0x10000 || c > 0x10FFFF)) || (c >= 0xD800 && c <= 0xDFFF))
+    {
+        *cp = -1;
+        return 1;
+    }
+
+    *cp = c;
+    return n;
+}
+
+// encode cp as UTF-8 into buf (room for 4 bytes), returns the length
+int editorEncodeChar(int cp, char* buf)
+{
+    if (cp < 0x80)
+    {
+        buf[0] = cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        buf[0] = 0xC0 | (cp >> 6);
+        buf[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        buf[0] = 0xE0 | (cp >> 12);
+        buf[1] = 0x80 | ((cp >> 6) & 0x3F);
+        buf[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+
+    buf[0] = 0xF0 | (cp >> 18);
+    buf[1] = 0x80 | ((cp >> 12) & 0x3F);
+    buf[2] = 0x80 | ((cp >> 6) & 0x3F);
+    buf[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+// index of the first byte of the character that byte 'at' of s (len bytes) belongs to
+int editorCharStart(const char* s, int len, int at)
+{
+    int start, cp;
+
+    // a character is at most 4 bytes, so its lead byte is at most 3 bytes back
+    for (start = at; start > 0 && start > at - 3 && ((unsigned char)s[start] & 0xC0) == 0x80; start--);
+
+    if (start < at && start + editorDecodeChar(&s[start], len - start, &cp) > at) return start;
+    return at;
+}
+
+// width class of a codepoint: a lookup in the block stage1 points at (cp is -1 for invalid bytes)
+int editorWidthClass(int cp)
+{
+    if (cp < 0) return WC_NONPRINT;
+    if (cp < 0x80) return (cp < 0x20 || cp == 0x7F) ? WC_NONPRINT : WC_NARROW;
+
+    const unsigned char* block = WCW_BLOCKS[WCW_STAGE1[cp >> WCW_BLOCK_BITS]];
+    int i = cp & ((1 << WCW_BLOCK_BITS) - 1);
+
+    return (block[i / 4] >> ((i % 4) * 2)) & 3;
+}
+
+// columns taken by a character that starts at render column rx
+// for a tab: use rx % TAB_STOP to find out how many columns we are to the right of the last tab stop,
+// then subtract that from TAB_STOP to find out how many columns there are to the next tab stop
+int editorCharWidth(int cp, long rx)
+{
+    if (cp == '\t') return TAB_STOP - (rx % TAB_STOP);
+
+    int cls = editorWidthClass(cp);
+    return (cls == WC_NONPRINT) ? 1 : cls;
+}
+
+/*
+  Length of the run of "plain" bytes at the start of s: printable ASCII, or any other control character but tab.
+  Each of those is one character that's one column wide, so the run can be skipped without decoding it.
+  Most text is almost entirely plain, so this checks 16 (SSE2) or 32 (AVX2) bytes at once:
+  a byte is plain unless its top bit is set (the start or the middle of a multibyte character) or it's a tab.
+  Without SIMD it still checks 8 bytes at a time, in a 64-bit word.
+*/
+int editorAsciiRun(const char* s, int len)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256i tab32 = _mm256_set1_epi8('\t');
+
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)&s[i]);
+        unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(v, _mm256_cmpeq_epi8(v, tab32)));
+
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i tab16 = _mm_set1_epi8('\t');
+
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+        unsigned int mask = _mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, tab16)));
+
+        if (mask) return i + __builtin_ctz(mask);
+    }
+#else
+    for (; i + 8 <= len; i += 8)
+    {
+        unsigned long long w;
+        memcpy(&w, &s[i], 8);
+
+        // zero bytes of w ^ 0x0909... are tabs
+        unsigned long long t = w ^ 0x0909090909090909ull;
+        if ((w | ((t - 0x0101010101010101ull) & ~t)) & 0x8080808080808080ull) break;
+    }
+#endif
+
+    for (; i < len; i++)
+        if (((unsigned char)s[i] & 0x80) || s[i] == '\t') break;
+
+    return i;
+}
+
+// render column right after the len bytes of s, when they start at render column rx
+long editorStrWidth(const char* s, int len, long rx)
+{
+    int j = 0;
+
+    while (j < len)
+    {
+        int run = editorAsciiRun(&s[j], len - j);
+        j += run;
+        rx += run;
+
+        if (j < len)
+        {
+            int cp;
+            int n = editorDecodeChar(&s[j], len - j, &cp);
+
+            rx += editorCharWidth(cp, rx);
+            j += n;
+        }
+    }
+
+    return rx;
+}
+
+// index of the character in s (len bytes, starting at render column rx) that covers column 'col' (len if it's past the end)
+int editorStrColumnToIndex(const char* s, int len, long rx, long col)
+{
+    int j = 0;
+
+    while (j < len)
+    {
+        int run = editorAsciiRun(&s[j], len - j);
+
+        if (rx + run > col) return j + (col - rx);
+        j += run;
+        rx += run;
+
+        if (j < len)
+        {
+            int cp;
+            int n = editorDecodeChar(&s[j], len - j, &cp);
+            int w = editorCharWidth(cp, rx);
+
+            if (rx + w > col) return j;
+            rx += w;
+            j += n;
+        }
+    }
+
+    return len;
+}
+
+/*** syntax highlighting ***/
+// FNV-1a from a per-filetype seed, plus a final mix (tools/syntaxgen picks a seed that gives every keyword its own slot)
+unsigned int editorKeywordHash(const char* s, int len, unsigned int seed)
+{
+    unsigned int h = 2166136261u ^ seed;
+    int i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+
+    // the low bits only depend on the low bits of the seed so far, mix the high bits down
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+
+    return h;
+}
+
+// returns HL_KEYWORD1/HL_KEYWORD2 if the word is a keyword, HL_NORMAL otherwise (one hash and at most one memcmp)
+int editorKeywordLookup(struct editorSyntax* syntax, const char* word, int len)
+{
+    if (len < syntax->keyword_minlen || len > syntax->keyword_maxlen) return HL_NORMAL;
+
+    const struct hlKeyword* kw = &syntax->keywords[editorKeywordHash(word, len, syntax->keyword_seed) & syntax->keyword_mask];
+
+    if (kw->len == len && !memcmp(kw->word, word, len)) return kw->hl;
+    return HL_NORMAL;
+}
+
+/*
+  Highlight a single line of text into hl (one entry per byte), starting in the lexer state the previous row ended in.
+  Returns the state this line ends in, so the row below it can be highlighted without looking at anything above it.
+  This only looks at its arguments (never at E), so it's safe to call from the highlighter thread.
+
+  Every decision starts from the class of the current byte (one table lookup), so plain text and identifiers
+  are skipped a whole run at a time, and the delimiters are only compared where their first byte shows up.
+*/
+int editorHighlightLine(struct editorSyntax* syntax, const char* text, int len, unsigned char* hl, int state)
+{
+    memset(hl, HL_NORMAL, len);
+
+    if (syntax == NULL) return LEX_NORMAL;
+
+    const unsigned char* cls = syntax->classes;
+
+    int prev_sep = 1; // beginning of the line counts as a separator
+    int in_string = 0; // holds the quote character while inside a string
+    int in_comment = (state == LEX_MLCOMMENT);
+
+    int i = 0;
+    while (i < len) 
+    {
+        if (in_comment) 
+        {
+            // skip straight to the end of the comment (or the line)
+            int start = i;
+
+            while (i < len && !((cls[(unsigned char)text[i]] & CC_COMMENT_END) && !strncmp(&text[i], syntax->multiline_comment_end, syntax->mce_len)))
+                i++;
+
+            if (i < len) 
+            {
+                i += syntax->mce_len;
+                in_comment = 0;
+                prev_sep = 1;
+            }
+
+            memset(&hl[start], HL_MLCOMMENT, i - start);
+            continue;
+        }
+
+        unsigned char c = text[i];
+        unsigned char k = cls[c];
+
+        if (in_string) 
+        {
+            hl[i] = HL_STRING;
+
+            // escaped character, skip over it
+            if (c == '\\' && i + 1 < len) 
+            {
+                hl[i + 1] = HL_STRING;
+                i += 2;
+                continue;
+            }
+
+            if (c == in_string) in_string = 0;
+            i++;
+            prev_sep = 1;
+            continue;
+        }
+
+        if (k & CC_COMMENT) 
+        {
+            if (syntax->scs_len && !strncmp(&text[i], syntax->singleline_comment_start, syntax->scs_len)) 
+            {
+                memset(&hl[i], HL_COMMENT, len - i);
+                break;
+            }
+
+            if (syntax->mcs_len && syntax->mce_len && !strncmp(&text[i], syntax->multiline_comment_start, syntax->mcs_len)) 
+            {
+                memset(&hl[i], HL_MLCOMMENT, syntax->mcs_len);
+                i += syntax->mcs_len;
+                in_comment = 1;
+                continue;
+            }
+        }
+
+        if (k & CC_QUOTE) 
+        {
+            in_string = c;
+            hl[i] = HL_STRING;
+            i++;
+            continue;
+        }
+
+        unsigned char prev_hl = (i > 0) ? hl[i - 1] : HL_NORMAL;
+
+        if (((k & CC_DIGIT) && (prev_sep || prev_hl == HL_NUMBER)) || ((k & CC_NUMBER_DOT) && prev_hl == HL_NUMBER)) 
+        {
+            hl[i] = HL_NUMBER;
+            i++;
+            prev_sep = 0;
+            continue;
+        }
+
+        // a whole word at once: it's a keyword if it's preceded and followed by a separator and it's in the table
+        if (k & CC_WORD) 
+        {
+            int start = i;
+
+            while (i < len && (cls[(unsigned char)text[i]] & CC_WORD)) i++;
+
+            if (prev_sep && (i == len || (cls[(unsigned char)text[i]] & CC_SEPARATOR))) 
+            {
+                int kw = editorKeywordLookup(syntax, &text[start], i - start);
+                if (kw != HL_NORMAL) memset(&hl[start], kw, i - start);
+            }
+
+            prev_sep = 0;
+            continue;
+        }
+
+        prev_sep = (k & CC_SEPARATOR) != 0;
+        i++;
+    }
+
+    return in_comment ? LEX_MLCOMMENT : LEX_NORMAL;
+}
+
+// mark a row as needing to be highlighted again (nothing is recomputed here, see editorSyntaxSchedule())
+void editorInvalidateSyntax(long at)
+{
+    if (at < 0 || at >= E.buf->numrows) return;
+
+    editorRow(at)->hl_dirty = 1;
+    if (at < E.buf->hl_frontier) E.buf->hl_frontier = at;
+}
+
+/*
+  Highlighting runs on a separate thread, so a huge file (or an edit that opens a block comment near the top of one)
+  never stalls typing or drawing.
+
+  The main thread hands the worker a batch: private copies of the text of a run of consecutive rows,
+  plus the lexer state the first of them starts in. The worker highlights them in order and publishes each result
+  by bumping b->done (an atomic store). The main thread picks up finished results in editorSyntaxCollect(),
+  before drawing, and only installs a result if the row still has the version it was copied at.
+  Every row's hl is only ever touched by the main thread, so editorDrawRows() never takes a lock.
+
+  The mutex/condvar is only used to wake the worker up when a batch is handed over.
+*/
+// highlight the rows of a batch in order, publishing each one as it's done
+void editorSyntaxRun(struct hlBatch* b)
+{
+    int state = b->state;
+    int i;
+
+    for (i = 0; i < b->numrows; i++)
+    {
+        if (__atomic_load_n(&b->cancel, __ATOMIC_RELAXED)) break;
+
+        struct hlRow* r = &b->rows[i];
+        r->state_in = state;
+
+        if (r->chars)
+        {
+            r->hl = malloc(r->size ? r->size : 1);
+            state = editorHighlightLine(b->syntax, r->chars, r->size, r->hl, state);
+        }
+        r->state_out = state;
+
+        __atomic_store_n(&b->done, i + 1, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&b->finished, 1, __ATOMIC_RELEASE);
+}
+
+void* editorSyntaxWorker(void* arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        pthread_mutex_lock(&E.highlighter.lock);
+        while (E.highlighter.pending == NULL)
+            pthread_cond_wait(&E.highlighter.wake, &E.highlighter.lock);
+
+        struct hlBatch* b = E.highlighter.pending;
+        E.highlighter.pending = NULL;
+        pthread_mutex_unlock(&E.highlighter.lock);
+
+        editorSyntaxRun(b);
+
+        // wake up the main loop, which may be blocked waiting for a key (EAGAIN: the pipe is full, it's awake already)
+        while (write(E.highlighter.pipe[1], "h", 1) == -1 && errno != EAGAIN)
+        {
+            if (errno == EINTR) continue;
+
+            // the main loop can't be woken up any more: it highlights batches itself from now on (see editorSyntaxSubmit())
+            __atomic_store_n(&E.highlighter.failed, 1, __ATOMIC_RELEASE);
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+void editorSyntaxFreeBatch(struct hlBatch* b)
+{
+    int i;
+
+    for (i = 0; i < b->numrows; i++)
+    {
+        free(b->rows[i].chars);
+        free(b->rows[i].hl);
+    }
+
+    free(b->rows);
+    free(b);
+}
+
+/*
+  Install whatever results the worker has published so far.
+  A result is only used if the row is still the one that was copied (same version, versions are never reused).
+  If the row is the first stale row (E.buf->hl_frontier) and it was highlighted starting in the state the row above actually ends in,
+  the result is final: the row becomes clean, and if it now ends in a different state the row below gets marked dirty.
+  Otherwise the result was computed from a guess (see editorSyntaxSchedule()), so it's only shown, and the row stays dirty.
+
+  Returns 1 if anything on screen changed.
+*/
+int editorSyntaxCollect()
+{
+    struct hlBatch* b = E.highlighter.inflight;
+    if (b == NULL) return 0;
+
+    int finished = __atomic_load_n(&b->finished, __ATOMIC_ACQUIRE);
+    int done = __atomic_load_n(&b->done, __ATOMIC_ACQUIRE);
+    int changed = 0;
+
+    for (; b->installed < done; b->installed++)
+    {
+        struct hlRow* r = &b->rows[b->installed];
+
+        if (r->at >= E.buf->numrows || editorRow(r->at)->version != r->version) continue;
+
+        int state = (r->at > 0) ? editorRow(r->at - 1)->hl_state : LEX_NORMAL;
+        erow* row = editorRow(r->at);
+
+        free(row->hl);
+        row->hl = r->hl;
+        row->hl_current = 1;
+        r->hl = NULL;
+
+        if (r->at == E.buf->hl_frontier && r->state_in == state)
+        {
+            int old_state = row->hl_state;
+
+            row->hl_state = r->state_out;
+            row->hl_dirty = 0;
+            E.buf->hl_frontier++;
+
+            if (r->state_out != old_state) editorInvalidateSyntax(r->at + 1);
+        }
+        else
+        {
+            row->hl_dirty = 1;
+        }
+
+        if (r->at >= E.buf->rowoff && r->at < E.buf->rowoff + E.screenrows) changed = 1;
+    }
+
+    if (finished)
+    {
+        editorSyntaxFreeBatch(b);
+        E.highlighter.inflight = NULL;
+    }
+
+    return changed;
+}
+
+// copy rows [from, to) into a new batch and hand it to the worker
+void editorSyntaxSubmit(long from, long to)
+{
+    struct hlBatch* b = calloc(1, sizeof(struct hlBatch));
+    int i;
+
+    b->syntax = E.buf->syntax;
+    b->state = (from > 0) ? editorRow(from - 1)->hl_state : LEX_NORMAL;
+    b->numrows = to - from;
+    b->rows = calloc(b->numrows, sizeof(struct hlRow));
+
+    for (i = 0; i < b->numrows; i++)
+    {
+        erow* row = editorRow(from + i);
+        struct hlRow* r = &b->rows[i];
+
+        r->at = from + i;
+        r->version = row->version;
+        if (row->storage == ROW_CHUNKED) continue; // long rows aren't highlighted (chars stays NULL)
+
+        r->size = row->size;
+        r->chars = malloc(row->size + 1);
+        editorRowCopy(row, 0, row->size, r->chars);
+        r->chars[row->size] = '\0';
+    }
+
+    E.highlighter.inflight = b;
+
+    if (__atomic_load_n(&E.highlighter.failed, __ATOMIC_ACQUIRE))
+    {
+        editorSyntaxRun(b); // no worker: highlight it right here, it's picked up like the worker's would be
+        return;
+    }
+
+    pthread_mutex_lock(&E.highlighter.lock);
+    E.highlighter.pending = b;
+    pthread_cond_signal(&E.highlighter.wake);
+    pthread_mutex_unlock(&E.highlighter.lock);
+}
+
+/*
+  Decide what the worker should highlight next. The viewport always comes first:
+  - If a visible row has nothing to show (it was edited or never highlighted) and the rows above it are still stale,
+    the visible rows are highlighted right away, guessing that the row above ends in the state it last ended in.
+    That guess is almost always right, and if it isn't the colors get fixed once the rows above catch up.
+    A batch of rows outside the viewport that's still running is cancelled to make room for this.
+  - Otherwise, the stale rows are highlighted for real, from E.buf->hl_frontier down to the bottom of the viewport.
+  Nothing below the viewport is ever highlighted.
+
+  Returns 1 if the new batch contains rows on screen.
+*/
+int editorSyntaxSchedule()
+{
+    if (E.buf->syntax == NULL) return 0;
+
+    long last = E.buf->rowoff + E.screenrows;
+    if (last > E.buf->numrows) last = E.buf->numrows;
+
+    long first_missing = E.buf->rowoff;
+    while (first_missing < last && editorRow(first_missing)->hl_current)
+        first_missing++;
+
+    if (E.highlighter.inflight)
+    {
+        if (first_missing < last && !E.highlighter.inflight->visible)
+            __atomic_store_n(&E.highlighter.inflight->cancel, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    // skip over rows that are already up to date
+    while (E.buf->hl_frontier < last && !editorRow(E.buf->hl_frontier)->hl_dirty)
+        E.buf->hl_frontier++;
+
+    if (first_missing < last && E.buf->hl_frontier < first_missing)
+    {
+        editorSyntaxSubmit(first_missing, last);
+        E.highlighter.inflight->visible = 1;
+        return 1;
+    }
+
+    if (E.buf->hl_frontier < last)
+    {
+        long to = E.buf->hl_frontier + HL_BATCH_ROWS;
+        if (to > last) to = last;
+
+        editorSyntaxSubmit(E.buf->hl_frontier, to);
+        E.highlighter.inflight->visible = (to > E.buf->rowoff);
+        return E.highlighter.inflight->visible;
+    }
+
+    return 0;
+}
+
+// wait (at most HL_FRAME_WAIT_MS) for the worker to finish the batch it's on
+void editorSyntaxWait()
+{
+    struct pollfd pfd = { E.highlighter.pipe[0], POLLIN, 0 };
+    char buf[64];
+
+    while (E.highlighter.inflight && !__atomic_load_n(&E.highlighter.inflight->finished, __ATOMIC_ACQUIRE))
+    {
+        if (poll(&pfd, 1, HL_FRAME_WAIT_MS) <= 0) break;
+        while (read(E.highlighter.pipe[0], buf, sizeof(buf)) > 0);
+    }
+}
+
+// called when the worker signals us while we're waiting for a key: pick up the results, and queue up more work
+int editorSyntaxPoll()
+{
+    char buf[64];
+    while (read(E.highlighter.pipe[0], buf, sizeof(buf)) > 0);
+
+    int changed = editorSyntaxCollect();
+    editorSyntaxSchedule();
+
+    return changed;
+}
+
+void editorSyntaxInit()
+{
+    pthread_t thread;
+
+    if (pipe2(E.highlighter.pipe, O_NONBLOCK | O_CLOEXEC) == -1) die("pipe2");
+
+    pthread_mutex_init(&E.highlighter.lock, NULL);
+    pthread_cond_init(&E.highlighter.wake, NULL);
+    E.highlighter.pending = NULL;
+    E.highlighter.inflight = NULL;
+    E.highlighter.failed = 0;
+
+    if (pthread_create(&thread, NULL, editorSyntaxWorker, NULL) != 0) die("pthread_create");
+    pthread_detach(thread);
+}
+
+int editorSyntaxToColor(int hl) 
+{
+    switch (hl) 
+    {
+        case HL_COMMENT:
+        case HL_MLCOMMENT: return 36; // cyan
+        case HL_KEYWORD1: return 33; // yellow
+        case HL_KEYWORD2: return 32; // green
+        case HL_STRING: return 35; // magenta
+        case HL_NUMBER: return 31; // red
+        default: return 37; // white
+    }
+}
+
+// match the current filename against the filematch patterns of each filetype in HLDB
+void editorSelectSyntaxHighlight() 
+{
+    E.buf->syntax = NULL;
+    if (E.buf->filename == NULL) return;
+
+    char* ext = strrchr(E.buf->filename, '.');
+    unsigned int j;
+
+    for (j = 0; j < HLDB_ENTRIES; j++) 
+    {
+        struct editorSyntax* s = &HLDB[j];
+        unsigned int i = 0;
+
+        while (s->filematch[i]) 
+        {
+            int is_ext = (s->filematch[i][0] == '.');
+
+            if ((is_ext && ext && !strcmp(ext, s->filematch[i])) || (!is_ext && strstr(E.buf->filename, s->filematch[i]))) 
+            {
+                E.buf->syntax = s;
+                break;
+            }
+            i++;
+        }
+
+        if (E.buf->syntax) break;
+    }
+
+    // the rules changed, so every row has to be highlighted again (lazily, as it gets drawn)
+    long filerow;
+    for (filerow = 0; filerow < E.buf->numrows; filerow++)
+    {
+        erow* row = editorRow(filerow);
+
+        row->hl_dirty = 1;
+        row->hl_current = 0;
+    }
+    E.buf->hl_frontier = 0;
+}
+
+/*** row storage ***/
+/*
+  A file with millions of short lines would otherwise mean millions of tiny malloc()s: each one pays for a header
+  and gets rounded up to malloc's minimum chunk (32 bytes for a 10 byte line), and lines freed while editing
+  leave holes all over the heap.
+  So the contents of normal rows come from the buffer's arena instead:
+  - sizes up to SLAB_MAX are rounded up to one of SLAB_CLASSES size classes (8 byte steps up to 64, then 4 per power of 2),
+    with no header at all
+  - new pieces are bumped off the end of the current SLAB_SIZE slab, freed ones go on the free list of their class
+    and get reused first
+  - anything bigger is a plain malloc() (it's rare, and the header doesn't matter there)
+  - all the slabs are released at once when the buffer goes away (editorArenaRelease()); the arenas of all buffers share
+    up to SLAB_SPARE of them, so opening or reloading a file reuses what the last one gave back
+  The arena doesn't remember sizes: callers pass in the size they asked for (a row's size + 1 for its contents).
+*/
+// size class of an n byte piece (n <= SLAB_MAX)
+int editorSlabClass(int n)
+{
+    if (n <= 64) return (n <= 8) ? 0 : (n - 1) / 8;
+
+    int p = 6; // n is in (2^p, 2^(p + 1)]
+    while ((n - 1) >> (p + 1)) p++;
+
+    int step = 1 << (p - 2);
+    return 8 + (p - 6) * 4 + ((n - (1 << p)) + step - 1) / step - 1;
+}
+
+// how many bytes pieces of a size class actually have
+int editorSlabClassSize(int c)
+{
+    if (c < 8) return (c + 1) * 8;
+
+    int p = 6 + (c - 8) / 4;
+    return (1 << p) + ((c - 8) % 4 + 1) * (1 << (p - 2));
+}
+
+char* editorArenaAlloc(struct rowArena* a, long n)
+{
+    if (n > SLAB_MAX) return malloc(n);
+
+    int c = editorSlabClass(n);
+    char* p = a->free[c];
+
+    if (p)
+    {
+        memcpy(&a->free[c], p, sizeof(char*));
+        return p;
+    }
+
+    int size = editorSlabClassSize(c);
+
+    if (a->bump == NULL || a->bump_end - a->bump < size)
+    {
+        struct slab* s = E.spare_slabs;
+
+        if (s)
+        {
+            E.spare_slabs = s->next;
+            E.numspare--;
+        }
+        else if ((s = malloc(sizeof(struct slab) + SLAB_SIZE)) == NULL)
+        {
+            die("malloc");
+        }
+
+        s->next = a->slabs;
+        a->slabs = s;
+        a->bump = s->data;
+        a->bump_end = s->data + SLAB_SIZE;
+    }
+
+    p = a->bump;
+    a->bump += size;
+    return p;
+}
+
+// give back a piece that was allocated with size n
+void editorArenaFree(struct rowArena* a, char* p, long n)
+{
+    if (p == NULL) return;
+    if (n > SLAB_MAX)
+    {
+        free(p);
+        return;
+    }
+
+    int c = editorSlabClass(n);
+
+    memcpy(p, &a->free[c], sizeof(char*));
+    a->free[c] = p;
+}
+
+// resize a piece from n to new_n bytes; nothing moves as long as both sizes are in the same class
+char* editorArenaRealloc(struct rowArena* a, char* p, long n, long new_n)
+{
+    if (n > SLAB_MAX && new_n > SLAB_MAX) return realloc(p, new_n);
+    if (n <= SLAB_MAX && new_n <= SLAB_MAX && editorSlabClass(n) == editorSlabClass(new_n)) return p;
+
+    char* q = editorArenaAlloc(a, new_n);
+
+    memcpy(q, p, (n < new_n) ? n : new_n);
+    editorArenaFree(a, p, n);
+    return q;
+}
+
+// free every slab at once (whatever was allocated from them is gone, pieces bigger than SLAB_MAX aren't touched)
+void editorArenaRelease(struct rowArena* a)
+{
+    while (a->slabs)
+    {
+        struct slab* next = a->slabs->next;
+
+        if (E.numspare < SLAB_SPARE)
+        {
+            a->slabs->next = E.spare_slabs;
+            E.spare_slabs = a->slabs;
+            E.numspare++;
+        }
+        else
+        {
+            free(a->slabs);
+        }
+        a->slabs = next;
+    }
+
+    memset(a, 0, sizeof(*a));
+}
+
+/*** long rows ***/
+/*
+  Minified files can have a single line of tens of MB. Keeping that in one chars array means every keystroke
+  memmoves the rest of the line, and editorUpdateRow() measures all of it again.
+  So once a row grows past LONG_ROW_BYTES it's cut into chunks of at most ROW_CHUNK_MAX bytes:
+  - typing only moves the bytes of one chunk around (a full chunk gets split in two)
+  - editorDrawRows() only looks at the part of the row that's on screen
+  - each chunk remembers where it starts (cx and rx), so finding the chunk for a position is a binary search
+  - chunks are only ever cut between two characters, so a character never straddles two of them
+  - long rows aren't syntax highlighted
+  A chunked row that shrinks below LONG_ROW_BYTES / 2 goes back to being a normal row.
+
+  Tabs make the width of a chunk depend on the column it starts at, but only up to its first tab:
+  after that every column lines up with a tab stop, so the rest of the chunk has the same width no matter where it starts.
+  That's why a chunk keeps lead and tail instead of a single width, and moving chunks around never means re-reading them.
+*/
+void editorChunkMeasure(rowchunk* ch)
+{
+    char* tab = memchr(ch->data, '\t', ch->len);
+
+    ch->ascii = (editorAsciiRun(ch->data, ch->len) == ch->len);
+    ch->has_tab = (tab != NULL);
+
+    if (tab == NULL)
+    {
+        ch->lead = editorStrWidth(ch->data, ch->len, 0);
+        ch->tail = 0;
+        return;
+    }
+
+    // from the first tab on, count from the tab stop it ends on
+    int at = tab - ch->data;
+
+    ch->lead = editorStrWidth(ch->data, at, 0);
+    ch->tail = editorStrWidth(tab + 1, ch->len - at - 1, 0);
+}
+
+// render column right after a chunk that starts at render column rx
+long editorChunkEndRx(rowchunk* ch, long rx)
+{
+    if (!ch->has_tab) return rx + ch->lead;
+    return (rx + ch->lead) / TAB_STOP * TAB_STOP + TAB_STOP + ch->tail;
+}
+
+// recompute where every chunk starts, along with the row's size, rsize and ascii flag (a few adds per chunk)
+void editorRowIndexChunks(erow* row)
+{
+    long cx = 0;
+    long rx = 0;
+    int i;
+
+    row->ascii = 1;
+
+    for (i = 0; i < row->u.chunked.numchunks; i++)
+    {
+        row->u.chunked.chunks[i].cx = cx;
+        row->u.chunked.chunks[i].rx = rx;
+        cx += row->u.chunked.chunks[i].len;
+        rx = editorChunkEndRx(&row->u.chunked.chunks[i], rx);
+        if (!row->u.chunked.chunks[i].ascii) row->ascii = 0;
+    }
+
+    row->size = cx;
+    row->rsize = rx;
+}
+
+// index of the chunk that holds byte cx (the last chunk for cx == row->size)
+int editorRowFindChunk(erow* row, long cx)
+{
+    int lo = 0;
+    int hi = row->u.chunked.numchunks - 1;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+
+        if (row->u.chunked.chunks[mid].cx <= cx) lo = mid;
+        else hi = mid - 1;
+    }
+
+    return lo;
+}
+
+long editorRowChunkCxToRx(erow* row, long cx)
+{
+    rowchunk* ch = &row->u.chunked.chunks[editorRowFindChunk(row, cx)];
+    return editorStrWidth(ch->data, cx - ch->cx, ch->rx);
+}
+
+long editorRowChunkRxToCx(erow* row, long rx)
+{
+    int lo = 0;
+    int hi = row->u.chunked.numchunks - 1;
+
+    // find the last chunk starting at or to the left of rx
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+
+        if (row->u.chunked.chunks[mid].rx <= rx) lo = mid;
+        else hi = mid - 1;
+    }
+
+    rowchunk* ch = &row->u.chunked.chunks[lo];
+    return ch->cx + editorStrColumnToIndex(ch->data, ch->len, ch->rx, rx);
+}
+
+// copy len bytes starting at 'at' out of a chunked row
+void editorRowChunkCopy(erow* row, long at, long len, char* dst)
+{
+    int i = editorRowFindChunk(row, at);
+    int off = at - row->u.chunked.chunks[i].cx;
+
+    while (len > 0 && i < row->u.chunked.numchunks)
+    {
+        rowchunk* ch = &row->u.chunked.chunks[i];
+        long n = ch->len - off;
+        if (n > len) n = len;
+
+        memcpy(dst, &ch->data[off], n);
+        dst += n;
+        len -= n;
+        off = 0;
+        i++;
+    }
+}
+
+/*
+  Insert s at position 'at'. If it fits in the chunk that holds 'at', the chunk's tail is moved over (at most ROW_CHUNK_MAX bytes).
+  If it doesn't, that chunk plus the new text is cut into fresh chunks of about ROW_CHUNK_SIZE, leaving room to type into all of them.
+  Every cut is moved back to the start of the character it would land in.
+  Text going into an empty chunk (a row that's just been made chunked) is cut up right where it is, without copying it first.
+  The caller has to call editorUpdateRow() afterwards (chunk positions are stale until then).
+*/
+void editorRowChunkInsert(erow* row, long at, const char* s, long len)
+{
+    int i = editorRowFindChunk(row, at);
+    rowchunk* ch = &row->u.chunked.chunks[i];
+    int off = at - ch->cx;
+
+    if (ch->len + len <= ROW_CHUNK_MAX)
+    {
+        memmove(&ch->data[off + len], &ch->data[off], ch->len - off);
+        memcpy(&ch->data[off], s, len);
+        ch->len += len;
+        editorChunkMeasure(ch);
+        return;
+    }
+
+    long total = ch->len + len;
+    char* buf = NULL;
+    const char* src = s;
+
+    if (ch->len > 0)
+    {
+        buf = malloc(total);
+        memcpy(buf, ch->data, off);
+        memcpy(&buf[off], s, len);
+        memcpy(&buf[off + len], &ch->data[off], ch->len - off);
+        src = buf;
+    }
+    free(ch->data);
+
+    // a cut moves back by at most 3 bytes, so every chunk but the last gets more than ROW_CHUNK_SIZE - 4 bytes
+    long n = total / (ROW_CHUNK_SIZE - 3) + 1;
+    long k, start;
+
+    row->u.chunked.chunks = realloc(row->u.chunked.chunks, sizeof(rowchunk) * (row->u.chunked.numchunks + n - 1));
+    memmove(&row->u.chunked.chunks[i + n], &row->u.chunked.chunks[i + 1], sizeof(rowchunk) * (row->u.chunked.numchunks - i - 1));
+
+    for (k = 0, start = 0; start < total || k == 0; k++)
+    {
+        long end = start + ROW_CHUNK_SIZE;
+
+        if (end >= total) end = total;
+        else end = start + editorCharStart(&src[start], (total - end < 4) ? total - start : ROW_CHUNK_SIZE + 4, ROW_CHUNK_SIZE);
+
+        ch = &row->u.chunked.chunks[i + k];
+        ch->len = end - start;
+        ch->data = malloc(ROW_CHUNK_MAX);
+        memcpy(ch->data, &src[start], ch->len);
+        editorChunkMeasure(ch);
+        start = end;
+    }
+
+    // close the gap if fewer chunks were needed
+    memmove(&row->u.chunked.chunks[i + k], &row->u.chunked.chunks[i + n], sizeof(rowchunk) * (row->u.chunked.numchunks - i - 1));
+    row->u.chunked.numchunks += k - 1;
+
+    free(buf);
+}
+
+void editorRowChunkRemove(erow* row, int i)
+{
+    free(row->u.chunked.chunks[i].data);
+    memmove(&row->u.chunked.chunks[i], &row->u.chunked.chunks[i + 1], sizeof(rowchunk) * (row->u.chunked.numchunks - i - 1));
+    row->u.chunked.numchunks--;
+}
+
+// delete the len bytes at 'at' (one character, so they're in one chunk), merging the chunk into the next one once it gets small
+// (so deleting doesn't leave lots of tiny chunks)
+void editorRowChunkDelete(erow* row, long at, int len)
+{
+    int i = editorRowFindChunk(row, at);
+    rowchunk* ch = &row->u.chunked.chunks[i];
+    int off = at - ch->cx;
+
+    memmove(&ch->data[off], &ch->data[off + len], ch->len - off - len);
+    ch->len -= len;
+
+    if (i + 1 < row->u.chunked.numchunks && ch->len + row->u.chunked.chunks[i + 1].len <= ROW_CHUNK_SIZE)
+    {
+        rowchunk* next = &row->u.chunked.chunks[i + 1];
+
+        memcpy(&ch->data[ch->len], next->data, next->len);
+        ch->len += next->len;
+        editorRowChunkRemove(row, i + 1);
+    }
+
+    if (ch->len == 0 && row->u.chunked.numchunks > 1) editorRowChunkRemove(row, i);
+    else editorChunkMeasure(ch);
+}
+
+// drop everything from 'at' to the end of the row
+void editorRowChunkTruncate(erow* row, long at)
+{
+    int i = editorRowFindChunk(row, at);
+    rowchunk* ch = &row->u.chunked.chunks[i];
+
+    ch->len = at - ch->cx;
+    editorChunkMeasure(ch);
+
+    while (row->u.chunked.numchunks > i + 1) editorRowChunkRemove(row, row->u.chunked.numchunks - 1);
+    if (ch->len == 0 && row->u.chunked.numchunks > 1) editorRowChunkRemove(row, i);
+}
+
+// make a row a chunked one holding the len bytes of s (the chunks take the place of whatever contents it had)
+void editorRowSetChunks(erow* row, const char* s, long len)
+{
+    row->storage = ROW_CHUNKED;
+    row->u.chunked.chunks = malloc(sizeof(rowchunk));
+    row->u.chunked.numchunks = 1;
+    row->u.chunked.chunks[0].data = malloc(ROW_CHUNK_MAX);
+    row->u.chunked.chunks[0].len = 0;
+    row->u.chunked.chunks[0].cx = 0;
+    row->u.chunked.chunks[0].rx = 0;
+    editorRowChunkInsert(row, 0, s, len);
+}
+
+// turn a normal row into a chunked one (it's always on the heap, it's too long to be inline)
+void editorRowMakeChunked(erow* row)
+{
+    char* chars = row->u.heap.chars;
+    int* rxmap = row->u.heap.rxmap;
+
+    editorRowSetChunks(row, chars, row->size);
+
+    editorArenaFree(&E.buf->arena, chars, row->size + 1);
+    free(rxmap);
+    free(row->hl);
+    row->hl = NULL;
+}
+
+// turn a chunked row back into a normal one (editorUpdateRow() measures it afterwards)
+void editorRowMakeFlat(erow* row)
+{
+    rowchunk* chunks = row->u.chunked.chunks;
+    int numchunks = row->u.chunked.numchunks;
+    char small[ROW_INLINE_SIZE];
+    char* chars = (row->size < ROW_INLINE_SIZE) ? small : editorArenaAlloc(&E.buf->arena, row->size + 1);
+    int i;
+
+    editorRowChunkCopy(row, 0, row->size, chars);
+    chars[row->size] = '\0';
+
+    for (i = 0; i < numchunks; i++) free(chunks[i].data);
+    free(chunks);
+
+    if (chars == small)
+    {
+        row->storage = ROW_INLINE;
+        memcpy(row->u.small, small, row->size + 1);
+    }
+    else
+    {
+        row->storage = ROW_HEAP;
+        row->u.heap.chars = chars;
+        row->u.heap.rxmap = NULL;
+    }
+}
+
+
+/*** row tree ***/
+/*
+  The rows are kept in a B+ tree instead of one array, so inserting or deleting a line in the middle of a file
+  with millions of them doesn't move every row after it:
+  - leaves hold up to BLOCK_ROWS consecutive rows (allocated once, a leaf never grows)
+  - inner nodes hold up to NODE_CHILDREN children, in order
+  - every node counts the rows and the bytes below it
+  Finding row n, or the row a byte offset is in, is one walk from the root down (editorRow(), editorRowAtOffset()).
+  Inserting or deleting a row only moves the rest of its leaf, and fixes up the counts on the way back up.
+  A full node is split before something goes in (at the point of insertion if that's the end, so reading a file fills
+  its leaves all the way), and a node less than a quarter full is merged into a neighbour if they fit together.
+
+  Typing changes the size of a row all the time, so the byte counts aren't fixed up on every keystroke: the leaf of the row
+  that changed is remembered (E.buf->stale_leaf), and only when another leaf changes, or something needs the counts,
+  is it added up again (editorTreeSettle(), BLOCK_ROWS adds) and the difference passed up the tree.
+
+  Rows move when their leaf changes, so (like with the array before) an erow* is only good until a row is inserted or deleted.
+*/
+struct rowNode* editorNodeNew(int leaf)
+{
+    struct rowNode* n = calloc(1, sizeof(struct rowNode));
+
+    n->leaf = leaf;
+    if (leaf) n->rows = malloc(sizeof(erow) * BLOCK_ROWS);
+    else n->children = malloc(sizeof(struct rowNode*) * NODE_CHILDREN);
+
+    return n;
+}
+
+void editorNodeFree(struct rowNode* n)
+{
+    free(n->rows);
+    free(n->children);
+    free(n);
+}
+
+// add to the counts of a node and of everything above it
+void editorNodeAdjust(struct rowNode* n, long rows, long bytes)
+{
+    for (; n; n = n->parent)
+    {
+        n->numrows += rows;
+        n->numbytes += bytes;
+    }
+}
+
+// position of a node among its parent's children
+int editorNodeSlot(struct rowNode* n)
+{
+    int i = 0;
+
+    while (n->parent->children[i] != n) i++;
+    return i;
+}
+
+// bring the byte counts of the stale leaf (and everything above it) up to date
+void editorTreeSettle()
+{
+    struct rowNode* n = E.buf->stale_leaf;
+    long bytes = 0;
+    int i;
+
+    if (n == NULL) return;
+
+    for (i = 0; i < n->count; i++) bytes += n->rows[i].size + 1;
+    editorNodeAdjust(n, 0, bytes - n->numbytes);
+    E.buf->stale_leaf = NULL;
+}
+
+// the leaf row 'at' is in (0 <= at < E.buf->numrows), and the index of its first row in *first
+struct rowNode* editorRowLeaf(long at, long* first)
+{
+    struct rowNode* n = E.buf->row_leaf;
+
+    if (n && at >= E.buf->row_leaf_first && at < E.buf->row_leaf_first + n->count)
+    {
+        *first = E.buf->row_leaf_first;
+        return n;
+    }
+
+    n = E.buf->rows;
+    *first = 0;
+
+    while (!n->leaf)
+    {
+        int i = 0;
+
+        while (at >= *first + n->children[i]->numrows)
+            *first += n->children[i++]->numrows;
+        n = n->children[i];
+    }
+
+    E.buf->row_leaf = n;
+    E.buf->row_leaf_first = *first;
+    return n;
+}
+
+erow* editorRow(long at)
+{
+    if (E.buf->readonly) return editorViewRow(at);
+
+    long first;
+    struct rowNode* leaf = editorRowLeaf(at, &first);
+
+    return &leaf->rows[at - first];
+}
+
+// index of a row from a pointer to it, leaving its leaf in E.buf->row_leaf (a row was almost always just looked up, so that's where it is)
+long editorRowIndex(erow* row)
+{
+    struct rowNode* n = E.buf->row_leaf;
+    long first = 0;
+
+    if (n && row >= n->rows && row < n->rows + n->count) return E.buf->row_leaf_first + (row - n->rows);
+
+    while (first < E.buf->numrows)
+    {
+        n = editorRowLeaf(first, &first);
+        if (row >= n->rows && row < n->rows + n->count) return first + (row - n->rows);
+        first += n->count;
+    }
+
+    return -1;
+}
+
+// the row byte offset 'offset' of the file is in (the newline at the end of a row belongs to it), and where that row starts in *start
+long editorRowAtOffset(long offset, long* start)
+{
+    struct rowNode* n = E.buf->rows;
+    long at = 0;
+    int i = 0;
+
+    if (E.buf->readonly) return editorViewRowAtOffset(offset, start);
+
+    editorTreeSettle();
+    *start = 0;
+    if (n == NULL || offset >= n->numbytes) return E.buf->numrows;
+
+    while (!n->leaf)
+    {
+        i = 0;
+        while (offset >= *start + n->children[i]->numbytes)
+        {
+            *start += n->children[i]->numbytes;
+            at += n->children[i++]->numrows;
+        }
+        n = n->children[i];
+    }
+
+    for (i = 0; offset >= *start + n->rows[i].size + 1; i++)
+        *start += n->rows[i].size + 1;
+
+    return at + i;
+}
+
+/*
+  Split a full node, because something is about to go in at position 'pos'. The second part moves to a new node
+  right after it (which is returned), so the parent gets one more child: that may split the parent first, all the way up
+  to the root (which is how the tree grows taller). The byte counts have to be settled.
+*/
+struct rowNode* editorNodeSplit(struct rowNode* n, int pos)
+{
+    int max = n->leaf ? BLOCK_ROWS : NODE_CHILDREN;
+    int keep = (pos == max) ? max : max / 2;
+    struct rowNode* right = editorNodeNew(n->leaf);
+    struct rowNode* parent = n->parent;
+    long moved_rows = 0;
+    long moved_bytes = 0;
+    int slot, i;
+
+    if (parent == NULL)
+    {
+        parent = editorNodeNew(0);
+        parent->children[0] = n;
+        parent->count = 1;
+        parent->numrows = n->numrows;
+        parent->numbytes = n->numbytes;
+        n->parent = parent;
+        E.buf->rows = parent;
+    }
+
+    slot = editorNodeSlot(n) + 1;
+    if (parent->count == NODE_CHILDREN)
+    {
+        struct rowNode* parent_right = editorNodeSplit(parent, slot);
+
+        if (slot >= parent->count)
+        {
+            slot -= parent->count;
+            parent = parent_right;
+        }
+    }
+
+    memmove(&parent->children[slot + 1], &parent->children[slot], sizeof(struct rowNode*) * (parent->count - slot));
+    parent->children[slot] = right;
+    parent->count++;
+    right->parent = parent;
+
+    right->count = n->count - keep;
+    if (n->leaf)
+    {
+        memcpy(right->rows, &n->rows[keep], sizeof(erow) * right->count);
+        for (i = 0; i < right->count; i++)
+        {
+            moved_rows++;
+            moved_bytes += right->rows[i].size + 1;
+        }
+    }
+    else
+    {
+        memcpy(right->children, &n->children[keep], sizeof(struct rowNode*) * right->count);
+        for (i = 0; i < right->count; i++)
+        {
+            right->children[i]->parent = right;
+            moved_rows += right->children[i]->numrows;
+            moved_bytes += right->children[i]->numbytes;
+        }
+    }
+    n->count = keep;
+
+    // n and right can be under different parents now, so both paths up get their counts fixed
+    editorNodeAdjust(n, -moved_rows, -moved_bytes);
+    editorNodeAdjust(right, moved_rows, moved_bytes);
+
+    E.buf->row_leaf = NULL;
+    return right;
+}
+
+// something was removed from a node: drop it if it's empty, or merge it with a neighbour if it's under a quarter full and they fit in one
+void editorNodeShrink(struct rowNode* n)
+{
+    int max = n->leaf ? BLOCK_ROWS : NODE_CHILDREN;
+    struct rowNode* parent = n->parent;
+    struct rowNode* left;
+    struct rowNode* right;
+    int slot, i;
+
+    if (parent == NULL)
+    {
+        // an empty tree has no root, and a root with a single child is a level too many
+        if (n->count == 0)
+        {
+            editorNodeFree(n);
+            E.buf->rows = NULL;
+        }
+        else if (!n->leaf && n->count == 1)
+        {
+            E.buf->rows = n->children[0];
+            E.buf->rows->parent = NULL;
+            editorNodeFree(n);
+            editorNodeShrink(E.buf->rows);
+        }
+        return;
+    }
+
+    if (n->count >= max / 4) return;
+
+    slot = editorNodeSlot(n);
+    if (n->count == 0)
+    {
+        right = n;
+    }
+    else
+    {
+        if (slot + 1 < parent->count) left = n, right = parent->children[slot + 1];
+        else if (slot > 0) left = parent->children[slot - 1], right = n;
+        else return;
+
+        if (left->count + right->count > max) return;
+
+        // both have the same parent, so nothing above them changes
+        if (n->leaf)
+        {
+            memcpy(&left->rows[left->count], right->rows, sizeof(erow) * right->count);
+        }
+        else
+        {
+            memcpy(&left->children[left->count], right->children, sizeof(struct rowNode*) * right->count);
+            for (i = 0; i < right->count; i++) right->children[i]->parent = left;
+        }
+
+        left->count += right->count;
+        left->numrows += right->numrows;
+        left->numbytes += right->numbytes;
+        right->numrows = 0;
+        right->numbytes = 0;
+    }
+
+    slot = editorNodeSlot(right);
+    memmove(&parent->children[slot], &parent->children[slot + 1], sizeof(struct rowNode*) * (parent->count - slot - 1));
+    parent->count--;
+    editorNodeFree(right);
+
+    E.buf->row_leaf = NULL;
+    editorNodeShrink(parent);
+}
+
+// make room for a new row at index 'at' (0 <= at <= E.buf->numrows), returned as an empty inline row
+erow* editorTreeInsert(long at)
+{
+    if (E.buf->rows == NULL) E.buf->rows = editorNodeNew(1);
+
+    struct rowNode* n = E.buf->rows;
+    long first = 0;
+    int i;
+
+    editorTreeSettle();
+
+    // at the boundary between two leaves, the new row goes at the end of the first one
+    while (!n->leaf)
+    {
+        i = 0;
+        while (i < n->count - 1 && at > first + n->children[i]->numrows)
+            first += n->children[i++]->numrows;
+        n = n->children[i];
+    }
+
+    if (n->count == BLOCK_ROWS)
+    {
+        struct rowNode* right = editorNodeSplit(n, at - first);
+
+        if (at - first >= n->count)
+        {
+            first += n->count;
+            n = right;
+        }
+    }
+
+    i = at - first;
+    memmove(&n->rows[i + 1], &n->rows[i], sizeof(erow) * (n->count - i));
+    memset(&n->rows[i], 0, sizeof(erow));
+    n->count++;
+    editorNodeAdjust(n, 1, 1);
+    E.buf->numrows++;
+
+    E.buf->row_leaf = n;
+    E.buf->row_leaf_first = first;
+    return &n->rows[i];
+}
+
+// take row 'at' out of the tree (whatever it owns has to be freed already)
+void editorTreeDelete(long at)
+{
+    long first;
+    struct rowNode* n = editorRowLeaf(at, &first);
+    int i = at - first;
+
+    editorTreeSettle();
+    editorNodeAdjust(n, -1, -(n->rows[i].size + 1));
+    memmove(&n->rows[i], &n->rows[i + 1], sizeof(erow) * (n->count - i - 1));
+    n->count--;
+    E.buf->numrows--;
+
+    E.buf->row_leaf = NULL;
+    editorNodeShrink(n);
+}
+
+// a row's size may have changed: its leaf is the stale one from now on
+void editorTreeTouch(erow* row)
+{
+    if (editorRowIndex(row) == -1) return;
+
+    if (E.buf->stale_leaf != E.buf->row_leaf) editorTreeSettle();
+    E.buf->stale_leaf = E.buf->row_leaf;
+}
+
+void editorFreeTree(struct rowNode* n)
+{
+    int i;
+
+    if (n == NULL) return;
+    if (!n->leaf)
+        for (i = 0; i < n->count; i++) editorFreeTree(n->children[i]);
+    editorNodeFree(n);
+}
+
+
+/*** row operations (no worries about where the cursor is) ***/
+// contents of an inline or heap row (NULL for the others, see editorRowSegment())
+char* editorRowChars(erow* row)
+{
+    if (row->storage == ROW_INLINE) return row->u.small;
+    if (row->storage == ROW_HEAP) return row->u.heap.chars;
+    return NULL;
+}
+
+/*
+  Make room for new_size bytes (plus the NUL) in a normal row, and return its contents.
+  The first min(size, new_size) bytes stay where they are in the contents, but the contents themselves may move:
+  rows shorter than ROW_INLINE_SIZE live inside the erow (most lines are short, so most rows never allocate at all),
+  and move out to the arena once they grow past that (and back in when they shrink).
+  Every change of a normal row's size goes through here, before the caller sets row->size.
+*/
+char* editorRowResize(erow* row, long new_size)
+{
+    long keep = ((row->size < new_size) ? row->size : new_size) + 1;
+
+    if (new_size < ROW_INLINE_SIZE)
+    {
+        if (row->storage == ROW_HEAP)
+        {
+            char* chars = row->u.heap.chars;
+
+            free(row->u.heap.rxmap);
+            memcpy(row->u.small, chars, keep); // overwrites chars and rxmap in the row
+            editorArenaFree(&E.buf->arena, chars, row->size + 1);
+            row->storage = ROW_INLINE;
+        }
+
+        return row->u.small;
+    }
+
+    if (row->storage == ROW_INLINE)
+    {
+        char* chars = editorArenaAlloc(&E.buf->arena, new_size + 1);
+
+        memcpy(chars, row->u.small, keep);
+        row->storage = ROW_HEAP;
+        row->u.heap.chars = chars;
+        row->u.heap.rxmap = NULL;
+        return chars;
+    }
+
+    row->u.heap.chars = editorArenaRealloc(&E.buf->arena, row->u.heap.chars, row->size + 1, new_size + 1);
+    return row->u.heap.chars;
+}
+
+/*
+  Typing in the middle of a row means moving everything after the cursor over, for every key.
+  So the row the cursor is typing into gets a gap buffer instead (ROW_GAP): its contents are split around a gap at the cursor.
+  Typing fills the gap from the left and backspace widens it, so neither moves the rest of the row.
+  Bytes only move when the edit happens somewhere else in the row (just the ones between the gap and there),
+  and a gap that fills up is regrown to about the size of the row (so the buffer roughly doubles), so typing rarely reallocs.
+  Only one row has a gap at a time (E.buf->gap_row). It's closed (turned back into a normal row) when the cursor leaves the row,
+  and before anything that needs the row in one piece.
+*/
+void editorRowOpenGap(erow* row)
+{
+    if (row->storage != ROW_HEAP) return; // inline rows are too short to bother, long rows have chunks
+
+    int gap_len = row->size + ROW_GAP_MIN; // about as much room as there is text already
+    char* buf = malloc(row->size + gap_len + 1);
+
+    memcpy(buf, row->u.heap.chars, row->size);
+    buf[row->size + gap_len] = '\0';
+
+    editorArenaFree(&E.buf->arena, row->u.heap.chars, row->size + 1);
+
+    // the gap starts at the end, so every checkpoint the row had is before it and still holds
+    free(E.buf->gap_rxmap);
+    E.buf->gap_rxmap = row->u.heap.rxmap;
+    E.buf->gap_rxmap_len = row->u.heap.rxmap ? (row->size + RXMAP_STRIDE - 1) / RXMAP_STRIDE : 0;
+
+    row->storage = ROW_GAP;
+    row->u.gap.buf = buf;
+    row->u.gap.gap = row->size;
+    row->u.gap.gap_len = gap_len;
+}
+
+void editorRowCloseGap(erow* row)
+{
+    if (row->storage != ROW_GAP) return;
+
+    char* buf = row->u.gap.buf;
+    int gap = row->u.gap.gap;
+
+    memmove(&buf[gap], &buf[gap + row->u.gap.gap_len], row->size - gap + 1);
+    editorRowForgetGapRx();
+
+    // back to inline or arena storage, whichever the size calls for
+    long size = row->size;
+    row->storage = ROW_INLINE;
+    row->size = 0;
+    memcpy(editorRowResize(row, size), buf, size + 1);
+    row->size = size;
+
+    free(buf);
+}
+
+// move the gap of a row to 'at', making sure it's at least need bytes
+void editorRowMoveGap(erow* row, int at, int need)
+{
+    char* buf = row->u.gap.buf;
+    int gap = row->u.gap.gap;
+    int gap_len = row->u.gap.gap_len;
+
+    if (gap_len < need)
+    {
+        int new_len = row->size + need + ROW_GAP_MIN;
+
+        buf = realloc(buf, row->size + new_len + 1);
+        memmove(&buf[gap + new_len], &buf[gap + gap_len], row->size - gap + 1);
+        gap_len = new_len;
+    }
+
+    if (at < gap) memmove(&buf[at + gap_len], &buf[at], gap - at);
+    else if (at > gap) memmove(&buf[gap], &buf[gap + gap_len], at - gap);
+
+    row->u.gap.buf = buf;
+    row->u.gap.gap = at;
+    row->u.gap.gap_len = gap_len;
+}
+
+/*
+  Converting between cx and rx means adding up the widths of everything to the left, which on a huge line with tabs
+  is way too slow to do on every frame (editorScroll() needs it every time).
+  So a row on the heap that isn't plain ASCII gets a map of checkpoints: rxmap[k] is the render column of the character
+  that byte k * RXMAP_STRIDE belongs to (the checkpoint is the start of that character).
+  It's only built the first time it's needed, and thrown away by editorUpdateRow() whenever the row changes.
+  (Inline rows are too short to need one.)
+*/
+// fill in checkpoints k to last (the ones inside s, which is len bytes), walking s from byte j at render column rx: returns the next one to fill
+int editorRxMapFill(const char* s, int len, int* rxmap, int k, int last, int j, long rx)
+{
+    while (j < len && k <= last)
+    {
+        // every checkpoint inside a run of plain bytes is exactly where it says
+        int run = editorAsciiRun(&s[j], len - j);
+
+        for (; k <= last && k * RXMAP_STRIDE < j + run; k++) rxmap[k] = rx + (k * RXMAP_STRIDE - j);
+        j += run;
+        rx += run;
+
+        if (j < len && k <= last)
+        {
+            int cp;
+            int n = editorDecodeChar(&s[j], len - j, &cp);
+
+            // checkpoints that land on (or inside) this character get its column
+            for (; k <= last && k * RXMAP_STRIDE < j + n; k++) rxmap[k] = rx;
+            rx += editorCharWidth(cp, rx);
+            j += n;
+        }
+    }
+
+    if (k <= last && k * RXMAP_STRIDE == len) rxmap[k++] = rx;
+    return k;
+}
+
+void editorRowBuildRxMap(erow* row)
+{
+    int last = row->size / RXMAP_STRIDE;
+    int* rxmap = malloc(sizeof(int) * (last + 1));
+
+    editorRxMapFill(row->u.heap.chars, row->size, rxmap, 0, last, 0, 0);
+    row->u.heap.rxmap = rxmap;
+}
+
+// last checkpoint at or to the left of render column rx, among rxmap[0, last]
+int editorRxMapFind(const int* rxmap, int last, long rx)
+{
+    int lo = 0;
+    int hi = last;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+
+        if (rxmap[mid] <= rx) lo = mid;
+        else hi = mid - 1;
+    }
+
+    return lo;
+}
+
+/*
+  The row with the gap changes with every key, but only after the gap: so it keeps the checkpoints of the text before the gap
+  (E.buf->gap_rxmap), and the ones past where an edit happens are forgotten.
+  They're filled in as far as they're asked for, from the last one there is, so typing only ever walks the bytes since the last checkpoint.
+  Returns the render column of byte 'at', which is at most the gap.
+*/
+long editorRowGapRx(erow* row, int at)
+{
+    char* buf = row->u.gap.buf;
+    int gap = row->u.gap.gap;
+
+    if (at == 0) return 0;
+
+    int k = (at - 1) / RXMAP_STRIDE; // the last checkpoint before 'at' (so it's before the gap too)
+
+    if (k >= E.buf->gap_rxmap_len)
+    {
+        int from = E.buf->gap_rxmap_len - 1;
+        int j = (from >= 0) ? editorCharStart(buf, gap, from * RXMAP_STRIDE) : 0;
+
+        E.buf->gap_rxmap = realloc(E.buf->gap_rxmap, sizeof(int) * (k + 1));
+        if (E.buf->gap_rxmap == NULL) die("realloc");
+        E.buf->gap_rxmap_len = editorRxMapFill(buf, gap, E.buf->gap_rxmap, from + 1, k, j, (from >= 0) ? E.buf->gap_rxmap[from] : 0);
+    }
+
+    int j = editorCharStart(buf, gap, k * RXMAP_STRIDE);
+
+    return editorStrWidth(&buf[j], at - j, E.buf->gap_rxmap[k]);
+}
+
+// the row with the gap was edited at byte 'at': checkpoints from there on don't hold anymore
+void editorRowGapEdited(int at)
+{
+    int keep = (at + RXMAP_STRIDE - 1) / RXMAP_STRIDE;
+
+    if (E.buf->gap_rxmap_len > keep) E.buf->gap_rxmap_len = keep;
+}
+
+void editorRowForgetGapRx()
+{
+    free(E.buf->gap_rxmap);
+    E.buf->gap_rxmap = NULL;
+    E.buf->gap_rxmap_len = 0;
+}
+
+// converts a chars index into a render index: jump to the checkpoint at or before cx, and add up at most RXMAP_STRIDE bytes from there
+long editorRowCxToRx(erow* row, long cx) // basically a function for working with lines with tabs and wide characters in them
+{
+    if (row->ascii) return cx; // every character is 1 column wide
+    if (row->storage == ROW_CHUNKED) return editorRowChunkCxToRx(row, cx);
+    if (row->storage == ROW_INLINE) return editorStrWidth(row->u.small, cx, 0);
+    if (row->storage == ROW_GAP)
+    {
+        // checkpoints up to the gap, and from there the bytes after it (the cursor is usually right at the gap)
+        int gap = row->u.gap.gap;
+
+        if (cx <= gap) return editorRowGapRx(row, cx);
+        return editorStrWidth(&row->u.gap.buf[gap + row->u.gap.gap_len], cx - gap, editorRowGapRx(row, gap));
+    }
+    if (row->u.heap.rxmap == NULL) editorRowBuildRxMap(row);
+
+    char* chars = row->u.heap.chars;
+    int k = cx / RXMAP_STRIDE;
+    int j = (k * RXMAP_STRIDE < row->size) ? editorCharStart(chars, row->size, k * RXMAP_STRIDE) : row->size;
+
+    return editorStrWidth(&chars[j], cx - j, row->u.heap.rxmap[k]);
+}
+
+// converts a render index into a chars index (of the character covering that column): binary search the checkpoints, then walk forward
+long editorRowRxToCx(erow* row, long rx)
+{
+    if (row->ascii) return (rx < row->size) ? rx : row->size;
+    if (row->storage == ROW_CHUNKED) return editorRowChunkRxToCx(row, rx);
+    if (row->storage == ROW_INLINE) return editorStrColumnToIndex(row->u.small, row->size, 0, rx);
+    if (row->storage == ROW_GAP)
+    {
+        char* buf = row->u.gap.buf;
+        int gap = row->u.gap.gap;
+        long gap_rx = editorRowGapRx(row, gap); // fills in every checkpoint before the gap
+
+        if (rx >= gap_rx) return gap + editorStrColumnToIndex(&buf[gap + row->u.gap.gap_len], row->size - gap, gap_rx, rx);
+
+        int k = editorRxMapFind(E.buf->gap_rxmap, (gap - 1) / RXMAP_STRIDE, rx);
+        int j = editorCharStart(buf, gap, k * RXMAP_STRIDE);
+
+        return j + editorStrColumnToIndex(&buf[j], gap - j, E.buf->gap_rxmap[k], rx);
+    }
+    if (row->u.heap.rxmap == NULL) editorRowBuildRxMap(row);
+
+    char* chars = row->u.heap.chars;
+    int* rxmap = row->u.heap.rxmap;
+    int lo = editorRxMapFind(rxmap, row->size / RXMAP_STRIDE, rx);
+    int j = (lo * RXMAP_STRIDE < row->size) ? editorCharStart(chars, row->size, lo * RXMAP_STRIDE) : row->size;
+
+    return j + editorStrColumnToIndex(&chars[j], row->size - j, rxmap[lo], rx);
+}
+
+// where the contiguous bytes holding position cx are: chars for a normal row, one side of the gap, or the chunk's data for a long row
+// (returns a pointer to byte 'start' of the row, the segment is len bytes long)
+const char* editorRowSegment(erow* row, long cx, long* start, long* len)
+{
+    if (row->storage == ROW_INLINE || row->storage == ROW_HEAP)
+    {
+        *start = 0;
+        *len = row->size;
+        return editorRowChars(row);
+    }
+
+    if (row->storage == ROW_GAP)
+    {
+        int gap = row->u.gap.gap;
+
+        if (cx < gap)
+        {
+            *start = 0;
+            *len = gap;
+            return row->u.gap.buf;
+        }
+
+        *start = gap;
+        *len = row->size - gap;
+        return &row->u.gap.buf[gap + row->u.gap.gap_len];
+    }
+
+    rowchunk* ch = &row->u.chunked.chunks[editorRowFindChunk(row, cx)];
+    *start = ch->cx;
+    *len = ch->len;
+    return ch->data;
+}
+
+// length in bytes of the character at cx (cx < row->size), and its codepoint (-1 if it isn't valid UTF-8)
+int editorRowCharLen(erow* row, long cx, int* cp)
+{
+    long start, len;
+    const char* s = editorRowSegment(row, cx, &start, &len);
+
+    return editorDecodeChar(&s[cx - start], len - (cx - start), cp);
+}
+
+// index of the first byte of the character that byte 'at' belongs to
+long editorRowCharStart(erow* row, long at)
+{
+    long start, len;
+    const char* s = editorRowSegment(row, at, &start, &len);
+
+    return start + editorCharStart(s, len, at - start);
+}
+
+// copy len bytes starting at 'at' out of any row, one segment at a time
+void editorRowCopy(erow* row, long at, long len, char* dst)
+{
+    while (len > 0)
+    {
+        long start, n;
+        const char* s = editorRowSegment(row, at, &start, &n);
+
+        n -= at - start;
+        if (n > len) n = len;
+
+        memcpy(dst, &s[at - start], n);
+        dst += n;
+        at += n;
+        len -= n;
+    }
+}
+
+// bring a row's storage (flat or chunked) and its width up to date with its contents
+void editorRowMeasure(erow* row)
+{
+    if (row->storage == ROW_CHUNKED) editorRowIndexChunks(row); // row->size is stale after editing chunks
+    if (row->storage == ROW_GAP && row->size > LONG_ROW_BYTES) editorRowCloseGap(row);
+    if (row->storage != ROW_CHUNKED && row->size > LONG_ROW_BYTES) editorRowMakeChunked(row);
+    if (row->storage == ROW_CHUNKED && row->size < LONG_ROW_BYTES / 2) editorRowMakeFlat(row);
+
+    if (row->storage == ROW_CHUNKED)
+    {
+        // every chunk is measured already, just find out where each one starts now
+        editorRowIndexChunks(row);
+    }
+    else if (row->storage == ROW_GAP)
+    {
+        // deleting from a plain row, or typing plain characters into it, keeps it plain (editorRowInsertChar() clears ascii otherwise),
+        // so typing doesn't even look at the rest of the row
+        if (!row->ascii)
+        {
+            char* buf = row->u.gap.buf;
+            int gap = row->u.gap.gap;
+            char* after = &buf[gap + row->u.gap.gap_len];
+
+            row->ascii = (editorAsciiRun(buf, gap) == gap && editorAsciiRun(after, row->size - gap) == row->size - gap);
+            row->rsize = row->ascii ? row->size : editorStrWidth(after, row->size - gap, editorRowGapRx(row, gap));
+        }
+        else
+        {
+            row->rsize = row->size;
+        }
+    }
+    else
+    {
+        char* chars = editorRowChars(row);
+        int run = editorAsciiRun(chars, row->size);
+
+        row->ascii = (run == row->size);
+        row->rsize = row->ascii ? row->size : editorStrWidth(&chars[run], row->size - run, run);
+
+        if (row->storage == ROW_HEAP)
+        {
+            free(row->u.heap.rxmap);
+            row->u.heap.rxmap = NULL;
+        }
+    }
+}
+
+void editorUpdateRow(erow* row)
+{
+    uint64_t t = editorTraceBegin();
+
+    editorRowMeasure(row);
+
+    row->version = ++E.version_clock;
+    row->hl_current = 0;
+    editorTreeTouch(row);
+    editorInvalidateSyntax(editorRowIndex(row));
+
+    editorTraceEnd(TRACE_UPDATE_ROW, t);
+}
+
+// give an empty inline row the len bytes of s as its contents (not measured yet, see editorRowMeasure())
+void editorRowSet(erow* row, const char* s, long len)
+{
+    if (len > LONG_ROW_BYTES)
+    {
+        editorRowSetChunks(row, s, len); // straight from s, a huge line isn't copied in one piece first
+    }
+    else
+    {
+        char* chars = editorRowResize(row, len);
+        memcpy(chars, s, len);
+        chars[len] = '\0';
+    }
+
+    row->size = len;
+    row->rsize = 0;
+    row->ascii = 1;
+    row->hl = NULL;
+    row->hl_current = 0;
+    row->hl_state = LEX_NORMAL;
+    row->hl_dirty = 1;
+}
+
+// First validate 'at', then let the row tree make room at the specified index for the new row.
+void editorInsertRow(long at, char* s, size_t len)
+{
+    if (at < 0 || at > E.buf->numrows) return;
+
+    erow* row = editorTreeInsert(at); // an empty inline row
+    if (E.buf->gap_row >= at) E.buf->gap_row++;
+
+    editorRowSet(row, s, len);
+    editorUpdateRow(row);
+    editorInvalidateSyntax(at + 1); // the row below starts right after a different row now
+
+    E.buf->dirty++;
+}
+
+// free memory owned by the erow being deleted 
+/*
+  First we validate the at index. 
+  Then we free the memory owned by the row using editorFreeRow(). 
+  We then use memmove() to overwrite the deleted row struct with the rest of the rows that come after it, and decrement numrows.
+*/
+void editorFreeRow(erow* row)
+{
+    int i;
+
+    if (row->storage == ROW_CHUNKED)
+    {
+        for (i = 0; i < row->u.chunked.numchunks; i++) free(row->u.chunked.chunks[i].data);
+        free(row->u.chunked.chunks);
+    }
+    else if (row->storage == ROW_HEAP)
+    {
+        editorArenaFree(&E.buf->arena, row->u.heap.chars, row->size + 1);
+        free(row->u.heap.rxmap);
+    }
+    else if (row->storage == ROW_GAP)
+    {
+        free(row->u.gap.buf);
+        editorRowForgetGapRx();
+    }
+
+    free(row->hl);
+}
+
+// free every row at once: only what didn't come from the arena is freed one by one, then the arena goes as a whole
+void editorFreeRows()
+{
+    long j;
+
+    for (j = 0; j < E.buf->numrows; j++)
+    {
+        erow* row = editorRow(j);
+
+        if (row->storage == ROW_HEAP)
+        {
+            if (row->size + 1 > SLAB_MAX) free(row->u.heap.chars);
+            free(row->u.heap.rxmap);
+            row->storage = ROW_INLINE;
+        }
+        editorFreeRow(row);
+    }
+
+    editorArenaRelease(&E.buf->arena);
+    editorFreeTree(E.buf->rows);
+    E.buf->rows = NULL;
+    E.buf->row_leaf = NULL;
+    E.buf->stale_leaf = NULL;
+    E.buf->numrows = 0;
+    E.buf->hl_frontier = 0;
+    E.buf->gap_row = -1;
+}
+
+void editorDelRow(long at) 
+{
+    if (at < 0 || at >= E.buf->numrows) return;
+    editorFreeRow(editorRow(at));
+    editorTreeDelete(at);
+
+    if (E.buf->gap_row == at) E.buf->gap_row = -1;
+    else if (E.buf->gap_row > at) E.buf->gap_row--;
+
+    editorInvalidateSyntax(at);
+    E.buf->dirty++;
+}
+
+// inserts a single character (a codepoint, stored as UTF-8) into an erow at a given position, returns how many bytes it took
+int editorRowInsertChar(erow* row, long at, int c) 
+{
+    char buf[4];
+    int len = editorEncodeChar(c, buf);
+
+    if (at < 0 || at > row->size) at = row->size;
+
+    if (row->storage == ROW_CHUNKED)
+    {
+        editorRowChunkInsert(row, at, buf, len);
+    }
+    else if (row->storage == ROW_GAP)
+    {
+        editorRowMoveGap(row, at, len);
+        editorRowGapEdited(at);
+        memcpy(&row->u.gap.buf[at], buf, len);
+        row->u.gap.gap += len;
+        row->u.gap.gap_len -= len;
+        row->size += len;
+
+        if (editorAsciiRun(buf, len) != len) row->ascii = 0;
+    }
+    else
+    {
+        char* chars = editorRowResize(row, row->size + len);
+
+        memmove(&chars[at + len], &chars[at], row->size - at + 1);
+        memcpy(&chars[at], buf, len);
+
+        row->size += len;
+    }
+    
+    editorUpdateRow(row);
+    E.buf->dirty++;
+
+    return len;
+}
+
+// appends string to the end of a row
+/*
+  The row’s new size is row->size + len + 1 (including the null byte), so first we make that much room in the row (editorRowResize()).
+  Then we simply memcpy() the given string to the end of the contents of the row.
+  We update row->size, call editorUpdateRow() as usual
+*/
+void editorRowAppendString(erow* row, char* s, size_t len)
+{
+    editorRowCloseGap(row);
+
+    if (row->storage == ROW_CHUNKED)
+    {
+        editorRowChunkInsert(row, row->size, s, len);
+    }
+    else
+    {
+        char* chars = editorRowResize(row, row->size + len);
+
+        memcpy(&chars[row->size], s, len);
+        row->size += len;
+        chars[row->size] = '\0';
+    }
+    editorUpdateRow(row);
+    E.buf->dirty++;
+}
+
+// drop everything from 'at' to the end of the row
+void editorRowTruncate(erow* row, long at)
+{
+    editorRowCloseGap(row);
+
+    if (row->storage == ROW_CHUNKED)
+    {
+        editorRowChunkTruncate(row, at);
+    }
+    else
+    {
+        char* chars = editorRowResize(row, at);
+
+        row->size = at;
+        chars[row->size] = '\0';
+    }
+
+    editorUpdateRow(row);
+}
+
+// use memmove() to overwrite the deleted character (all of its bytes) with the characters that come after it
+void editorRowDelChar(erow* row, long at)
+{
+    if (at < 0 || at >= row->size) return;
+
+    int cp;
+    int len = editorRowCharLen(row, at, &cp);
+
+    if (row->storage == ROW_CHUNKED)
+    {
+        editorRowChunkDelete(row, at, len);
+    }
+    else if (row->storage == ROW_GAP)
+    {
+        // the character ends up right after the gap, which then swallows it
+        editorRowMoveGap(row, at, 0);
+        editorRowGapEdited(at);
+        row->u.gap.gap_len += len;
+        row->size -= len;
+    }
+    else
+    {
+        char* chars = editorRowChars(row);
+
+        memmove(&chars[at], &chars[at + len], row->size - at - len + 1);
+        editorRowResize(row, row->size - len);
+        row->size -= len;
+    }
+
+    editorUpdateRow(row);
+    E.buf->dirty++;
+}
+
+
+/*** viewer ***/
+/*
+  -R opens files for viewing only, and doesn't read them: a file is mmap()ed, and its rows are looked up in the map when they're needed.
+  So a file of tens of GB opens at once, and the memory used depends on the size of the screen rather than of the file:
+  - a sparse index has where every VIEW_INDEX_STRIDE-th line starts, so getting to line n is a lookup
+    and a memchr() over at most VIEW_INDEX_STRIDE lines (straight from the page cache)
+  - the index is built lazily: the file is only searched for newlines as far as someone has looked (or jumped) into it yet,
+    so E.buf->numrows grows on the way down (the status bar shows a '+' after it until the whole file has been seen)
+  - a window of VIEW_WINDOW_ROWS rows around the last one asked for is decoded into erows, so drawing and moving the cursor
+    work on them like on any other row; asking for a row outside of it (editorRow()) decodes a new window there
+  Nothing can be changed, and there's no syntax highlighting (logs don't have a filetype anyway).
+*/
+// search for newlines until row 'at' is known and byte 'offset' is passed (or the end of the file is reached)
+void editorViewScan(long at, long offset)
+{
+    struct fileView* v = &E.buf->view;
+
+    while (v->scanned < v->size && (v->lines <= at || v->scanned <= offset))
+    {
+        char* nl = memchr(&v->map[v->scanned], '\n', v->size - v->scanned);
+
+        v->scanned = nl ? nl - v->map + 1 : v->size;
+        v->lines++;
+
+        if (v->lines % VIEW_INDEX_STRIDE == 0)
+        {
+            if (v->numindex == v->indexcap)
+            {
+                v->indexcap *= 2;
+                v->index = realloc(v->index, sizeof(long) * v->indexcap);
+            }
+            v->index[v->numindex++] = v->scanned;
+        }
+    }
+
+    E.buf->numrows = v->lines;
+}
+
+// where the line after the one starting at 'start' starts
+long editorViewNext(long start)
+{
+    char* nl = memchr(&E.buf->view.map[start], '\n', E.buf->view.size - start);
+
+    return nl ? nl - E.buf->view.map + 1 : E.buf->view.size;
+}
+
+// where row 'at' starts (it has to be scanned already)
+long editorViewStart(long at)
+{
+    long start = E.buf->view.index[at / VIEW_INDEX_STRIDE];
+    long i;
+
+    for (i = at - at % VIEW_INDEX_STRIDE; i < at; i++) start = editorViewNext(start);
+    return start;
+}
+
+erow* editorViewRow(long at)
+{
+    struct fileView* v = &E.buf->view;
+    int i;
+
+    if (at >= v->window_first && at < v->window_first + v->window_count)
+        return &v->window[at - v->window_first];
+
+    for (i = 0; i < v->window_count; i++) editorFreeRow(&v->window[i]);
+
+    // mostly scrolling down, so more of the window goes below the row than above it
+    v->window_first = at - VIEW_WINDOW_ROWS / 4;
+    if (v->window_first < 0) v->window_first = 0;
+
+    editorViewScan(v->window_first + VIEW_WINDOW_ROWS - 1, -1);
+    v->window_count = (E.buf->numrows - v->window_first < VIEW_WINDOW_ROWS) ? E.buf->numrows - v->window_first : VIEW_WINDOW_ROWS;
+
+    long start = editorViewStart(v->window_first);
+
+    for (i = 0; i < v->window_count; i++)
+    {
+        erow* row = &v->window[i];
+        long next = editorViewNext(start);
+        long end = (next > start && v->map[next - 1] == '\n') ? next - 1 : next;
+
+        while (end > start && v->map[end - 1] == '\r') end--;
+
+        memset(row, 0, sizeof(erow)); // an empty inline row
+        editorRowSet(row, &v->map[start], end - start);
+        editorRowMeasure(row);
+        row->version = ++E.version_clock;
+
+        start = next;
+    }
+
+    return &v->window[at - v->window_first];
+}
+
+// the row byte offset 'offset' is in, and where that row starts in *start (like editorRowAtOffset())
+long editorViewRowAtOffset(long offset, long* start)
+{
+    struct fileView* v = &E.buf->view;
+    long lo = 0;
+    long hi = v->numindex - 1;
+
+    editorViewScan(-1, offset);
+
+    *start = 0;
+    if (offset >= v->size) return E.buf->numrows;
+
+    // the last indexed line starting at or before offset, then line by line from there
+    while (lo < hi)
+    {
+        long mid = (lo + hi + 1) / 2;
+
+        if (v->index[mid] <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+
+    long at = lo * VIEW_INDEX_STRIDE;
+    long next;
+
+    *start = v->index[lo];
+    while ((next = editorViewNext(*start)) <= offset)
+    {
+        *start = next;
+        at++;
+    }
+
+    return at;
+}
+
+// find query after the cursor (wrapping around at the end of the file) and put the cursor on it, returns 0 if it isn't there
+int editorViewFind(const char* query, long len)
+{
+    struct fileView* v = &E.buf->view;
+
+    if (v->size == 0) return 0;
+
+    long from = (E.buf->cy < E.buf->numrows) ? editorViewStart(E.buf->cy) + E.buf->cx + 1 : v->size;
+    if (from > v->size) from = v->size;
+
+    char* match = memmem(&v->map[from], v->size - from, query, len);
+    if (match == NULL) match = memmem(v->map, (from + len - 1 < v->size) ? from + len - 1 : v->size, query, len);
+    if (match == NULL) return 0;
+
+    long start;
+
+    E.buf->cy = editorViewRowAtOffset(match - v->map, &start);
+    E.buf->cx = match - v->map - start;
+    return 1;
+}
+
+void editorViewClose()
+{
+    struct fileView* v = &E.buf->view;
+    int i;
+
+    for (i = 0; i < v->window_count; i++) editorFreeRow(&v->window[i]);
+    if (v->map) munmap(v->map, v->size);
+    free(v->window);
+    free(v->index);
+    memset(v, 0, sizeof(struct fileView));
+    E.buf->numrows = 0;
+}
+
+// map a file for viewing (editorOpen() does this with -R)
+void editorViewOpen(char* filename)
+{
+    struct fileView* v = &E.buf->view;
+    struct stat st;
+
+    editorViewClose();
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) == -1) die("open");
+
+    v->size = st.st_size;
+    if (v->size > 0)
+    {
+        v->map = mmap(NULL, v->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (v->map == MAP_FAILED) die("mmap");
+    }
+    close(fd); // the mapping keeps the file open
+
+    v->indexcap = 1024;
+    v->index = malloc(sizeof(long) * v->indexcap);
+    v->index[0] = 0; // line 0
+    v->numindex = 1;
+    v->window = malloc(sizeof(erow) * VIEW_WINDOW_ROWS);
+
+    E.buf->syntax = NULL;
+    E.buf->dirty = 0;
+}
+
+
+/*** reload ***/
+/*
+  Reading the file again (it changed on disk, or Ctrl-R) only replaces the rows that differ from it, so everything else
+  (the rows, their highlighting, where the cursor and the screen are) stays as it is:
+  - every line of the file and every row is hashed (a line and a row with the same hash and length are taken to be the same)
+  - the lines both of them start and end with are skipped
+  - what's left in the middle is diffed line by line (Myers' algorithm, on the hashes), which gives the runs of rows to replace;
+    if they differ in more than RELOAD_MAX_EDITS lines, the whole middle is replaced instead
+  - the runs are replaced from the bottom up, so the rows above a run are still where the diff saw them,
+    and the cursor and the top of the screen move along with the rows they're on
+*/
+// a line of the file (start is where it is in the map) or a row of the buffer (start isn't used)
+struct reloadLine
+{
+    long start;
+    long len;
+    unsigned long hash;
+};
+
+// FNV-1a, going on from h
+unsigned long editorHashBytes(unsigned long h, const char* s, long len)
+{
+    long i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+unsigned long editorRowHash(erow* row)
+{
+    unsigned long h = HASH_BASIS;
+    long cx = 0;
+
+    while (cx < row->size)
+    {
+        long start, len;
+        const char* s = editorRowSegment(row, cx, &start, &len);
+
+        h = editorHashBytes(h, &s[cx - start], len - (cx - start));
+        cx = start + len;
+    }
+    return h;
+}
+
+int editorLinesSame(struct reloadLine* a, struct reloadLine* b)
+{
+    return a->hash == b->hash && a->len == b->len;
+}
+
+// where row y ends up after the rows [at, at + del) are replaced by ins new ones (inside the run: as far down it as it was, if it can)
+long editorReloadMove(long y, long at, long del, long ins)
+{
+    if (y >= at + del) return y + ins - del;
+    if (y < at) return y;
+    if (y - at < ins) return y;
+    return (ins > 0) ? at + ins - 1 : at;
+}
+
+// replace the rows [at, at + del) with the lines [0, ins) of the file in map
+void editorReloadReplace(long at, long del, struct reloadLine* lines, long ins, char* map)
+{
+    long i;
+
+    E.buf->cy = editorReloadMove(E.buf->cy, at, del, ins);
+    E.buf->rowoff = editorReloadMove(E.buf->rowoff, at, del, ins);
+
+    for (i = 0; i < del; i++) editorDelRow(at);
+    for (i = 0; i < ins; i++) editorInsertRow(at + i, &map[lines[i].start], lines[i].len);
+}
+
+/*
+  Myers' O(ND) diff of the rows a[0, n) (which are rows [base, base + n)) against the lines b[0, m), replacing every run of rows
+  that differs from the bottom up. Every V (the furthest x reached on each diagonal k = x - y after d edits) is kept,
+  to walk the path back afterwards.
+  Returns how many lines changed, or -1 (having changed nothing) if it's more than RELOAD_MAX_EDITS.
+*/
+long editorReloadDiff(struct reloadLine* a, long n, struct reloadLine* b, long m, char* map, long base)
+{
+    long limit = (n + m < RELOAD_MAX_EDITS) ? n + m : RELOAD_MAX_EDITS;
+    long** trace = malloc(sizeof(long*) * (limit + 1));
+    long* v = malloc(sizeof(long) * (2 * limit + 3));
+    long d, k, x, y;
+    long changed = 0;
+    int found = 0;
+
+#define V(k) v[(k) + limit + 1]
+    V(1) = 0;
+    for (d = 0; d <= limit && !found; d++)
+    {
+        for (k = -d; k <= d; k += 2)
+        {
+            x = (k == -d || (k != d && V(k - 1) < V(k + 1))) ? V(k + 1) : V(k - 1) + 1;
+            y = x - k;
+
+            while (x < n && y < m && editorLinesSame(&a[x], &b[y]))
+            {
+                x++;
+                y++;
+            }
+
+            V(k) = x;
+            if (x >= n && y >= m) found = 1;
+        }
+
+        trace[d] = malloc(sizeof(long) * (2 * d + 1));
+        memcpy(trace[d], &V(-d), sizeof(long) * (2 * d + 1));
+    }
+#undef V
+
+    long edits = d - 1;
+    long ex = -1, ey = -1; // where the run of changed lines being walked back through ends (-1: not in one)
+
+    // back from (n, m): every step is a diagonal (lines that are the same) from (x, y) back to (sx, sy), and an edit before it
+    x = n;
+    y = m;
+    for (d = edits; found && d >= 0; d--)
+    {
+        long px = 0, py = 0, sx = 0, sy = 0;
+
+        if (d > 0)
+        {
+            long* pv = &trace[d - 1][d - 1]; // pv[k] is V(k) after d - 1 edits
+            long pk;
+
+            k = x - y;
+            pk = (k == -d || (k != d && pv[k - 1] < pv[k + 1])) ? k + 1 : k - 1;
+            px = pv[pk];
+            py = px - pk;
+            sx = (pk == k + 1) ? px : px + 1;
+            sy = sx - k;
+        }
+
+        if ((x > sx || d == 0) && ex != -1)
+        {
+            editorReloadReplace(base + x, ex - x, &b[y], ey - y, map);
+            changed += (ex - x > ey - y) ? ex - x : ey - y;
+            ex = -1;
+        }
+
+        if (d > 0 && ex == -1)
+        {
+            ex = sx;
+            ey = sy;
+        }
+
+        x = px;
+        y = py;
+    }
+
+    for (d = 0; d <= edits; d++) free(trace[d]);
+    free(trace);
+    free(v);
+    return found ? changed : -1;
+}
+
+// Ctrl-R: read the file again
+void editorReload()
+{
+    if (E.buf->filename == NULL) return;
+
+    if (E.buf->hexmode)
+    {
+        // map it again, dropping the changed pages (the cursor stays on the same offset, if the file is still that long)
+        long offset = E.buf->cy * HEX_ROW_BYTES + E.buf->cx;
+
+        editorHexClose();
+        editorHexOpen(E.buf->filename);
+        editorWatchStart(E.buf->filename, NULL, E.buf->hex.size, 0);
+        editorHexSeek(offset);
+        editorSetStatusMessage("Reloaded %.40s: %ld bytes", E.buf->filename, E.buf->hex.size);
+        return;
+    }
+
+    if (E.buf->readonly)
+    {
+        // nothing is decoded for good with -R: just map it again
+        editorViewOpen(E.buf->filename);
+        editorWatchStart(E.buf->filename, NULL, E.buf->view.size, 0);
+        editorViewScan(E.buf->cy, -1);
+        if (E.buf->cy > E.buf->numrows) E.buf->cy = E.buf->numrows;
+        E.buf->cx = 0;
+        return;
+    }
+
+    struct stat st;
+    int fd = open(E.buf->filename, O_RDONLY);
+    char* map = NULL;
+
+    if (fd == -1 || fstat(fd, &st) == -1 || (st.st_size > 0 && (map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED))
+    {
+        editorSetStatusMessage("Can't reload: %s", strerror(errno));
+        if (fd != -1) close(fd);
+        return;
+    }
+    close(fd);
+
+    long size = st.st_size;
+    long n = E.buf->numrows;
+    long m = 0;
+    long cap = 1024;
+    long at = 0;
+    long j;
+    struct reloadLine* a = malloc(sizeof(struct reloadLine) * (n + 1));
+    struct reloadLine* b = malloc(sizeof(struct reloadLine) * cap);
+
+    // split the file into lines the way editorOpen() does
+    while (at < size)
+    {
+        char* nl = memchr(&map[at], '\n', size - at);
+        long next = nl ? nl - map + 1 : size;
+        long len = next - at;
+
+        while (len > 0 && (map[at + len - 1] == '\n' || map[at + len - 1] == '\r')) len--;
+
+        if (m == cap)
+        {
+            cap *= 2;
+            b = realloc(b, sizeof(struct reloadLine) * cap);
+        }
+
+        b[m].start = at;
+        b[m].len = len;
+        b[m].hash = editorHashBytes(HASH_BASIS, &map[at], len);
+        m++;
+        at = next;
+    }
+
+    for (j = 0; j < n; j++)
+    {
+        erow* row = editorRow(j);
+
+        a[j].len = row->size;
+        a[j].hash = editorRowHash(row);
+    }
+
+    long pre = 0;
+    long suf = 0;
+
+    while (pre < n && pre < m && editorLinesSame(&a[pre], &b[pre])) pre++;
+    while (suf < n - pre && suf < m - pre && editorLinesSame(&a[n - 1 - suf], &b[m - 1 - suf])) suf++;
+
+    long changed = editorReloadDiff(&a[pre], n - pre - suf, &b[pre], m - pre - suf, map, pre);
+
+    if (changed == -1)
+    {
+        editorReloadReplace(pre, n - pre - suf, &b[pre], m - pre - suf, map);
+        changed = (n > m ? n : m) - pre - suf;
+    }
+
+    if (E.buf->cy < E.buf->numrows) E.buf->cx = editorRowRxToCx(editorRow(E.buf->cy), E.buf->rx); // same column as before
+    else E.buf->cx = 0;
+
+    E.buf->dirty = 0;
+    editorWatchStart(E.buf->filename, &st, size, size > 0 && map[size - 1] != '\n');
+    editorSetStatusMessage("Reloaded %.40s: %ld lines changed", E.buf->filename, changed);
+
+    if (map) munmap(map, size);
+    free(a);
+    free(b);
+}
+
+
+/*** watching the file ***/
+/*
+  The file is watched with inotify, so changes other programs make to it don't go unnoticed:
+  - if nothing is unsaved, the buffer is reloaded (editorReload(), which only touches the rows that changed)
+  - otherwise the status bar says so, and saving over it takes a second Ctrl-S (Ctrl-R reloads it, dropping what's unsaved)
+  Writes only count once the file is closed (IN_CLOSE_WRITE), so a file being rewritten isn't reloaded halfway through
+  (except with -f, which has to keep up with a log that stays open).
+  Our own saves change the file too, so E.buf->watch remembers what the file looked like (inode, size, mtime)
+  when it was last read or written, and it has only changed if it doesn't look like that anymore.
+  Editors that save by writing a new file and renaming it over the old one replace the inode: the new one is watched then.
+
+  -f follows a file the way tail -f does: only the bytes past what was read already are read (pread() from E.buf->watch.offset)
+  and added as rows, so a growing log is never read again from the start.
+  A last line without a newline yet is continued by what comes after it.
+  With -R the map is just made bigger (the new lines are indexed when they're looked at, or at once if the end is on screen).
+  If the end of the file was on screen, it stays there: the screen (and the cursor with it) scrolls along.
+*/
+void editorWatchStop()
+{
+    if (E.buf->watch.inotify != -1) close(E.buf->watch.inotify);
+    if (E.buf->watch.fd != -1) close(E.buf->watch.fd);
+    E.buf->watch.inotify = -1;
+    E.buf->watch.wd = -1;
+    E.buf->watch.fd = -1;
+}
+
+// remember what the file looks like now
+void editorWatchRecord(struct stat* st)
+{
+    E.buf->watch.dev = st->st_dev;
+    E.buf->watch.ino = st->st_ino;
+    E.buf->watch.size = st->st_size;
+    E.buf->watch.mtime = st->st_mtim;
+}
+
+int editorWatchSame(struct stat* st)
+{
+    return st->st_dev == E.buf->watch.dev && st->st_ino == E.buf->watch.ino && st->st_size == E.buf->watch.size &&
+           st->st_mtim.tv_sec == E.buf->watch.mtime.tv_sec && st->st_mtim.tv_nsec == E.buf->watch.mtime.tv_nsec;
+}
+
+// has another program changed the file since it was last read or written?
+int editorWatchChanged()
+{
+    struct stat st;
+
+    if (E.buf->filename == NULL || E.buf->watch.ino == 0 || stat(E.buf->filename, &st) == -1) return 0;
+    return !editorWatchSame(&st);
+}
+
+/*
+  Start watching a file that was just read (up to 'offset': with -f, what comes after it is appended) or written.
+  st is what it looked like before it was read, so changes made while it was being read aren't taken for what was read (NULL: look now).
+  The inotify instance is kept (events already queued for the file aren't lost), only what it watches changes.
+*/
+void editorWatchStart(char* filename, struct stat* st, long offset, int partial)
+{
+    struct stat now;
+
+    if (E.buf->watch.fd != -1) close(E.buf->watch.fd);
+    E.buf->watch.fd = E.buf->follow ? open(filename, O_RDONLY) : -1;
+    E.buf->watch.offset = offset;
+    E.buf->watch.partial = partial;
+    E.buf->watch.ino = 0;
+
+    if (E.buf->watch.inotify == -1) E.buf->watch.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    int wd = (E.buf->watch.inotify == -1) ? -1 : inotify_add_watch(E.buf->watch.inotify, filename, WATCH_EVENTS);
+
+    if (E.buf->watch.wd != -1 && E.buf->watch.wd != wd) inotify_rm_watch(E.buf->watch.inotify, E.buf->watch.wd); // a different file than before
+    E.buf->watch.wd = wd;
+
+    if (st == NULL && stat(filename, &now) == 0) st = &now;
+    if (wd == -1 || st == NULL || (E.buf->follow && E.buf->watch.fd == -1))
+    {
+        editorSetStatusMessage("Can't watch %.40s: %s", filename, strerror(errno));
+        editorWatchStop();
+        return;
+    }
+
+    editorWatchRecord(st);
+}
+
+// read what was appended to the file, up to 'size', into rows
+void editorFollowRead(long size)
+{
+    struct editorWatch* f = &E.buf->watch;
+    char* buf = malloc(FOLLOW_READ_SIZE);
+    int dirty = E.buf->dirty; // rows that came from the file don't make it differ from the file
+
+    while (f->offset < size)
+    {
+        ssize_t n = pread(f->fd, buf, (size - f->offset < FOLLOW_READ_SIZE) ? size - f->offset : FOLLOW_READ_SIZE, f->offset);
+
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        f->offset += n;
+
+        long at = 0;
+        while (at < n)
+        {
+            char* nl = memchr(&buf[at], '\n', n - at);
+            long end = nl ? nl - buf : n;
+            long len = end - at;
+
+            while (nl && len > 0 && buf[at + len - 1] == '\r') len--;
+
+            if (f->partial && E.buf->numrows > 0)
+            {
+                erow* row = editorRow(E.buf->numrows - 1);
+
+                editorRowAppendString(row, &buf[at], len);
+
+                // the '\r' of a "\r\n" that was split between two reads (or two appends) came with the part before
+                while (nl && row->size > 0)
+                {
+                    char last;
+
+                    editorRowCopy(row, row->size - 1, 1, &last);
+                    if (last != '\r') break;
+                    editorRowTruncate(row, row->size - 1);
+                }
+            }
+            else
+            {
+                editorInsertRow(E.buf->numrows, &buf[at], len);
+            }
+
+            f->partial = (nl == NULL);
+            at = end + 1;
+        }
+    }
+
+    free(buf);
+    E.buf->dirty = dirty;
+}
+
+// -R: the file grew to 'size', map all of it
+void editorViewGrow(long size)
+{
+    struct fileView* v = &E.buf->view;
+    int i;
+
+    // the last line was counted without a newline at its end: it goes on in what was appended, so it's scanned again
+    if (v->scanned == v->size && v->size > 0 && v->map[v->size - 1] != '\n')
+    {
+        if (v->lines % VIEW_INDEX_STRIDE == 0) v->numindex--;
+        v->lines--;
+        v->scanned = editorViewStart(v->lines);
+        E.buf->numrows = v->lines;
+    }
+
+    char* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, E.buf->watch.fd, 0);
+    if (map == MAP_FAILED) return;
+
+    if (v->map) munmap(v->map, v->size);
+    v->map = map;
+    v->size = size;
+
+    // the window may end with the rows that just changed, and its rows point nowhere now anyway
+    for (i = 0; i < v->window_count; i++) editorFreeRow(&v->window[i]);
+    v->window_count = 0;
+}
+
+// inotify says the file changed: returns 1 if the buffer changed (or there's something to say about it)
+int editorWatchPoll()
+{
+    struct editorWatch* w = &E.buf->watch;
+    struct stat st;
+    long buf[1024]; // aligned for struct inotify_event
+    unsigned int mask = 0;
+    ssize_t n;
+
+    while ((n = read(w->inotify, buf, sizeof(buf))) > 0)
+    {
+        char* p = (char*)buf;
+
+        while (p < (char*)buf + n)
+        {
+            struct inotify_event* event = (struct inotify_event*)p;
+
+            mask |= event->mask;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    // a file that's being rewritten is only looked at once the writer closes it, rather than halfway (and emptied, at first)
+    if (!E.buf->follow && !(mask & ~IN_MODIFY)) return 0;
+    if (E.buf->filename == NULL || stat(E.buf->filename, &st) == -1) return 0; // gone (for now), nothing to read
+
+    int replaced = (st.st_dev != w->dev || st.st_ino != w->ino);
+
+    if (replaced) w->wd = inotify_add_watch(w->inotify, E.buf->filename, WATCH_EVENTS); // the new file (the old one's watch goes away with it)
+    if (editorWatchSame(&st)) return 0;
+
+    if (E.buf->follow && !E.buf->hexmode && !replaced && st.st_size > w->size)
+    {
+        long size = st.st_size;
+        int at_bottom = (E.buf->rowoff + E.screenrows >= E.buf->numrows) && (!E.buf->readonly || E.buf->view.scanned == E.buf->view.size);
+
+        if (E.buf->readonly)
+        {
+            editorViewGrow(size);
+            if (at_bottom) editorViewScan(-1, size);
+        }
+        else
+        {
+            editorFollowRead(size);
+        }
+        editorWatchRecord(&st);
+
+        if (at_bottom && E.buf->numrows > E.buf->rowoff + E.screenrows)
+        {
+            long by = E.buf->numrows - (E.buf->rowoff + E.screenrows);
+
+            E.buf->rowoff += by;
+            E.buf->cy += by;
+            if (E.buf->cy > E.buf->numrows) E.buf->cy = E.buf->numrows;
+            E.buf->cx = (E.buf->cy < E.buf->numrows) ? editorRowRxToCx(editorRow(E.buf->cy), E.buf->rx) : 0;
+        }
+        return 1;
+    }
+
+    if (E.buf->readonly || !E.buf->dirty)
+        editorReload();
+    else
+        editorSetStatusMessage("%.30s changed on disk! Ctrl-R reloads it, Ctrl-S twice overwrites it", E.buf->filename);
+
+    return 1;
+}
+
+
+/*** hex mode ***/
+/*
+  -x shows a file as bytes: every row is an offset, HEX_ROW_BYTES bytes in hex, and the same bytes as ASCII.
+  Like -R it maps the file instead of reading it, and rows are only put together for the lines on screen (editorHexDrawRow()),
+  so a disk image of many GB opens at once and nothing in it is ever changed by being split into lines.
+  Typing hex digits overwrites the byte under the cursor, a nibble at a time (the file never changes size).
+  The first change to a page copies it out of the map (E.buf->hex.pages), and saving pwrite()s just those pages back.
+  The cursor is on byte E.buf->cy * HEX_ROW_BYTES + E.buf->cx.
+*/
+// the copy of a page (NULL if it hasn't been changed), and where it is (or would go) in E.buf->hex.pages in *at
+unsigned char* editorHexFindPage(long page, int* at)
+{
+    int lo = 0;
+    int hi = E.buf->hex.numpages;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+
+        if (E.buf->hex.pages[mid].page < page) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if (at) *at = lo;
+    return (lo < E.buf->hex.numpages && E.buf->hex.pages[lo].page == page) ? E.buf->hex.pages[lo].data : NULL;
+}
+
+unsigned char editorHexByte(long offset)
+{
+    unsigned char* page = editorHexFindPage(offset / HEX_PAGE_SIZE, NULL);
+
+    return page ? page[offset % HEX_PAGE_SIZE] : E.buf->hex.map[offset];
+}
+
+// has the byte been changed since the file was saved?
+int editorHexChanged(long offset)
+{
+    unsigned char* page = editorHexFindPage(offset / HEX_PAGE_SIZE, NULL);
+
+    return page && page[offset % HEX_PAGE_SIZE] != E.buf->hex.map[offset];
+}
+
+void editorHexSetByte(long offset, unsigned char value)
+{
+    struct editorHex* h = &E.buf->hex;
+    long page = offset / HEX_PAGE_SIZE;
+    int at;
+    unsigned char* data = editorHexFindPage(page, &at);
+
+    if (data == NULL)
+    {
+        long start = page * HEX_PAGE_SIZE;
+        long len = (h->size - start < HEX_PAGE_SIZE) ? h->size - start : HEX_PAGE_SIZE;
+
+        if (h->numpages == h->pagecap)
+        {
+            h->pagecap = h->pagecap ? h->pagecap * 2 : 16;
+            h->pages = realloc(h->pages, sizeof(struct hexPage) * h->pagecap);
+        }
+
+        data = malloc(HEX_PAGE_SIZE);
+        memcpy(data, &h->map[start], len);
+
+        memmove(&h->pages[at + 1], &h->pages[at], sizeof(struct hexPage) * (h->numpages - at));
+        h->pages[at].page = page;
+        h->pages[at].data = data;
+        h->numpages++;
+    }
+
+    data[offset % HEX_PAGE_SIZE] = value;
+    E.buf->dirty++;
+}
+
+// put the cursor on a byte (the closest one there is)
+void editorHexSeek(long offset)
+{
+    if (offset > E.buf->hex.size - 1) offset = E.buf->hex.size - 1;
+    if (offset < 0) offset = 0;
+
+    E.buf->cy = offset / HEX_ROW_BYTES;
+    E.buf->cx = offset % HEX_ROW_BYTES;
+    E.buf->hex.nibble = 0;
+}
+
+// screen column of the cursor (in the hex digits of its byte)
+long editorHexColumn()
+{
+    return E.buf->hex.digits + 2 + E.buf->cx * 3 + (E.buf->cx >= HEX_ROW_BYTES / 2) + E.buf->hex.nibble;
+}
+
+// append the part of s that's on screen, s starting at column *col of the row
+void editorHexAppend(struct abuf* ab, const char* s, int len, long* col)
+{
+    long from = (E.buf->coloff > *col) ? E.buf->coloff - *col : 0;
+    long to = (E.buf->coloff + E.screencols - *col < len) ? E.buf->coloff + E.screencols - *col : len;
+
+    if (from < to) abAppend(ab, &s[from], to - from);
+    *col += len;
+}
+
+// draw a row: offset, bytes in hex (changed ones in red), and the same bytes as ASCII (the cursor's one inverted)
+void editorHexDrawRow(struct abuf* ab, long row)
+{
+    long start = row * HEX_ROW_BYTES;
+    int n = (E.buf->hex.size - start < HEX_ROW_BYTES) ? E.buf->hex.size - start : HEX_ROW_BYTES;
+    long cursor = E.buf->cy * HEX_ROW_BYTES + E.buf->cx;
+    long col = 0;
+    char buf[32];
+    int i;
+
+    editorHexAppend(ab, buf, snprintf(buf, sizeof(buf), "%0*lx  ", E.buf->hex.digits, start), &col);
+
+    for (i = 0; i < HEX_ROW_BYTES; i++)
+    {
+        if (i < n)
+        {
+            int changed = editorHexChanged(start + i);
+
+            if (changed) abAppend(ab, "\x1b[31m", 5);
+            editorHexAppend(ab, buf, snprintf(buf, sizeof(buf), "%02x ", editorHexByte(start + i)), &col);
+            if (changed) abAppend(ab, "\x1b[39m", 5);
+        }
+        else
+        {
+            editorHexAppend(ab, "   ", 3, &col);
+        }
+
+        if (i == HEX_ROW_BYTES / 2 - 1) editorHexAppend(ab, " ", 1, &col);
+    }
+
+    editorHexAppend(ab, " |", 2, &col);
+    for (i = 0; i < n; i++)
+    {
+        unsigned char b = editorHexByte(start + i);
+        char c = (b >= 32 && b < 127) ? b : '.';
+
+        if (start + i == cursor) abAppend(ab, "\x1b[7m", 4);
+        editorHexAppend(ab, &c, 1, &col);
+        if (start + i == cursor) abAppend(ab, "\x1b[m", 3);
+    }
+    editorHexAppend(ab, "|", 1, &col);
+}
+
+// handle a key in hex mode, returns 0 for the keys that do the same as with text (quitting, saving, searching, reloading, going to an offset)
+int editorHexKey(int c)
+{
+    struct editorHex* h = &E.buf->hex;
+    long offset = E.buf->cy * HEX_ROW_BYTES + E.buf->cx;
+    long page = (long)E.screenrows * HEX_ROW_BYTES;
+    int digit = -1;
+
+    if (c == CTRL_KEY('q') || c == CTRL_KEY('s') || c == CTRL_KEY('f') || c == CTRL_KEY('r') || c == CTRL_KEY('g') || c == CTRL_KEY('l') || c == CTRL_KEY('t') || c == CTRL_KEY('u') || c == CTRL_KEY('o') || c == CTRL_KEY('n') || c == CTRL_KEY('p') || c == CTRL_KEY('w') || c == '\x1b') return 0;
+    if (h->size == 0) return 1;
+
+    if (c >= '0' && c <= '9') digit = c - '0';
+    else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+
+    switch (c)
+    {
+        case ARROW_LEFT:
+        case BACKSPACE:
+        case CTRL_KEY('h'):
+            offset--;
+            break;
+        case ARROW_RIGHT:
+            offset++;
+            break;
+        case ARROW_UP:
+            if (offset >= HEX_ROW_BYTES) offset -= HEX_ROW_BYTES;
+            break;
+        case ARROW_DOWN:
+            if (offset + HEX_ROW_BYTES < h->size) offset += HEX_ROW_BYTES;
+            break;
+        case PAGE_UP:
+        case PAGE_DOWN:
+            // the screen moves a page, and the cursor with it
+            offset += (c == PAGE_UP) ? -page : page;
+            E.buf->rowoff += (c == PAGE_UP) ? -E.screenrows : E.screenrows;
+            if (E.buf->rowoff > E.buf->numrows - 1) E.buf->rowoff = E.buf->numrows - 1;
+            if (E.buf->rowoff < 0) E.buf->rowoff = 0;
+            break;
+        case HOME_KEY:
+            offset -= E.buf->cx;
+            break;
+        case END_KEY:
+            offset += HEX_ROW_BYTES - 1 - E.buf->cx;
+            break;
+        case FILE_START:
+            offset = 0;
+            break;
+        case FILE_END:
+            offset = h->size - 1;
+            break;
+        default:
+            if (digit == -1)
+            {
+                editorSetStatusMessage("Hex mode: type hex digits to change the byte under the cursor");
+                return 1;
+            }
+            if (!h->writable)
+            {
+                editorSetStatusMessage("Can't change %.40s: no permission to write it", E.buf->filename);
+                return 1;
+            }
+
+            {
+                unsigned char b = editorHexByte(offset);
+
+                editorHexSetByte(offset, h->nibble ? (b & 0xF0) | digit : (b & 0x0F) | (digit << 4));
+            }
+
+            // the high nibble first, then the low one, then on to the next byte
+            if (h->nibble) offset++;
+            else
+            {
+                h->nibble = 1;
+                return 1;
+            }
+            break;
+    }
+
+    editorHexSeek(offset);
+    return 1;
+}
+
+// copy len bytes of the file from offset on, as they are now (the changed pages, and the map for the rest)
+void editorHexCopy(long offset, long len, unsigned char* dst)
+{
+    while (len > 0)
+    {
+        unsigned char* page = editorHexFindPage(offset / HEX_PAGE_SIZE, NULL);
+        long n = HEX_PAGE_SIZE - offset % HEX_PAGE_SIZE;
+
+        if (n > len) n = len;
+        memcpy(dst, page ? &page[offset % HEX_PAGE_SIZE] : &E.buf->hex.map[offset], n);
+        dst += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+// first match of query that starts in [from, to), or -1: a page at a time, each with the len - 1 bytes after it (a match can cross pages)
+long editorHexSearch(const char* query, long len, long from, long to)
+{
+    long size = E.buf->hex.size;
+    unsigned char* window = malloc(HEX_PAGE_SIZE + len);
+    long found = -1;
+
+    while (found == -1 && from < to)
+    {
+        long n = (to - from < HEX_PAGE_SIZE) ? to - from : HEX_PAGE_SIZE;
+        long got = (from + n + len - 1 < size) ? n + len - 1 : size - from;
+
+        editorHexCopy(from, got, window);
+
+        unsigned char* match = memmem(window, got, query, len);
+        if (match && match - window < n) found = from + (match - window);
+        from += n;
+    }
+
+    free(window);
+    return found;
+}
+
+// Ctrl-F: find query (as bytes) after the cursor, wrapping around at the end of the file; returns 0 if it isn't there
+int editorHexFind(const char* query, long len)
+{
+    long size = E.buf->hex.size;
+    long from = E.buf->cy * HEX_ROW_BYTES + E.buf->cx + 1;
+
+    if (len == 0 || len > size) return 0;
+    if (from > size) from = size;
+
+    long at = editorHexSearch(query, len, from, size);
+    if (at == -1) at = editorHexSearch(query, len, 0, from);
+    if (at == -1) return 0;
+
+    editorHexSeek(at);
+    return 1;
+}
+
+// write the changed pages back to the file, and only those
+void editorHexSave()
+{
+    struct editorHex* h = &E.buf->hex;
+    long bytes = 0;
+    int i;
+
+    for (i = 0; i < h->numpages; i++)
+    {
+        long start = h->pages[i].page * HEX_PAGE_SIZE;
+        long len = (h->size - start < HEX_PAGE_SIZE) ? h->size - start : HEX_PAGE_SIZE;
+        long done = 0;
+
+        while (done < len)
+        {
+            ssize_t n = pwrite(h->fd, &h->pages[i].data[done], len - done, start + done);
+
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0)
+            {
+                editorSetStatusMessage("Save failed! I/O error: %s", strerror(errno));
+                return;
+            }
+            done += n;
+        }
+        bytes += len;
+    }
+
+    // the map shows what was written now
+    for (i = 0; i < h->numpages; i++) free(h->pages[i].data);
+    editorSetStatusMessage("%ld bytes (%d pages) written to disk", bytes, h->numpages);
+    h->numpages = 0;
+    E.buf->dirty = 0;
+    editorWatchStart(E.buf->filename, NULL, h->size, 0); // what the file looks like now is ours
+}
+
+// map a file to be shown as bytes (editorOpen() does this with -x)
+void editorHexOpen(char* filename)
+{
+    struct editorHex* h = &E.buf->hex;
+    struct stat st;
+
+    h->fd = E.buf->readonly ? -1 : open(filename, O_RDWR);
+    h->writable = (h->fd != -1);
+    if (h->fd == -1) h->fd = open(filename, O_RDONLY);
+    if (h->fd == -1 || fstat(h->fd, &st) == -1) die("open");
+
+    h->size = st.st_size;
+    h->map = NULL;
+    if (h->size > 0)
+    {
+        h->map = mmap(NULL, h->size, PROT_READ, MAP_SHARED, h->fd, 0); // shared: it shows what editorHexSave() writes
+        if (h->map == MAP_FAILED) die("mmap");
+    }
+
+    // 8 digits, or as many as the biggest offset needs
+    h->digits = 8;
+    while (h->size > 0 && h->digits < 16 && ((h->size - 1) >> (4 * h->digits)) != 0) h->digits++;
+
+    h->numpages = 0;
+    h->nibble = 0;
+    E.buf->numrows = (h->size + HEX_ROW_BYTES - 1) / HEX_ROW_BYTES;
+    E.buf->syntax = NULL;
+    E.buf->dirty = 0;
+}
+
+// unmap the file, dropping changes that weren't saved (its buffer is being closed)
+void editorHexClose()
+{
+    struct editorHex* h = &E.buf->hex;
+    int i;
+
+    for (i = 0; i < h->numpages; i++) free(h->pages[i].data);
+    free(h->pages);
+    if (h->map) munmap(h->map, h->size);
+    if (h->fd != -1) close(h->fd);
+
+    memset(h, 0, sizeof(*h));
+    h->fd = -1;
+}
+
+
+/*** memory ***/
+// what a row has allocated, besides the erow itself
+void editorMemoryRow(erow* row, struct editorMemory* m)
+{
+    if (row->hl) m->hl += row->size ? row->size : 1;
+
+    if (row->storage == ROW_HEAP)
+    {
+        if (row->size + 1 > SLAB_MAX) m->text += row->size + 1; // smaller ones are in the slabs, counted with them
+        if (row->u.heap.rxmap) m->rxmap += sizeof(int) * (row->size / RXMAP_STRIDE + 1);
+    }
+    else if (row->storage == ROW_GAP)
+    {
+        m->text += row->size + row->u.gap.gap_len + 1;
+        m->rxmap += sizeof(int) * E.buf->gap_rxmap_len;
+    }
+    else if (row->storage == ROW_CHUNKED)
+    {
+        m->text += row->u.chunked.numchunks * (sizeof(rowchunk) + ROW_CHUNK_MAX);
+    }
+}
+
+void editorMemoryNode(struct rowNode* node, struct editorMemory* m)
+{
+    int i;
+
+    m->nodes += sizeof(struct rowNode);
+
+    if (node->leaf)
+    {
+        m->nodes += BLOCK_ROWS * sizeof(erow);
+        for (i = 0; i < node->count; i++) editorMemoryRow(&node->rows[i], m);
+    }
+    else
+    {
+        m->nodes += NODE_CHILDREN * sizeof(struct rowNode*);
+        for (i = 0; i < node->count; i++) editorMemoryNode(node->children[i], m);
+    }
+}
+
+// count up what the buffer takes (walks every row: it's for the status command and benchmarks, not every frame)
+void editorMemoryUsage(struct editorMemory* m)
+{
+    struct slab* slab;
+    int i;
+
+    memset(m, 0, sizeof(*m));
+
+    if (E.buf->rows) editorMemoryNode(E.buf->rows, m);
+    for (slab = E.buf->arena.slabs; slab; slab = slab->next) m->text += sizeof(struct slab) + SLAB_SIZE;
+    m->text += E.numspare * (sizeof(struct slab) + SLAB_SIZE); // spare slabs are shared, but they're here to be used
+
+    m->view = E.buf->view.indexcap * sizeof(long);
+    if (E.buf->view.window)
+    {
+        struct editorMemory w = { 0 };
+
+        m->view += VIEW_WINDOW_ROWS * sizeof(erow);
+        for (i = 0; i < E.buf->view.window_count; i++) editorMemoryRow(&E.buf->view.window[i], &w);
+        m->view += w.text + w.hl + w.rxmap;
+    }
+
+    m->hex = E.buf->hex.pagecap * sizeof(struct hexPage) + (long)E.buf->hex.numpages * HEX_PAGE_SIZE;
+    m->total = m->nodes + m->text + m->hl + m->rxmap + m->view + m->hex;
+    m->frame_peak = E.frame_peak;
+}
+
+// n bytes, short: 512B, 12.3K, 4.5M, 1.2G
+void editorFormatBytes(long n, char* buf, int len)
+{
+    if (n < 1024) snprintf(buf, len, "%ldB", n);
+    else if (n < 1024 * 1024) snprintf(buf, len, "%.1fK", n / 1024.0);
+    else if (n < 1024L * 1024 * 1024) snprintf(buf, len, "%.1fM", n / (1024.0 * 1024));
+    else snprintf(buf, len, "%.1fG", n / (1024.0 * 1024 * 1024));
+}
+
+// the status command (Ctrl-U)
+void editorShowMemory()
+{
+    struct editorMemory m;
+    const char* names[] = { "rows", "text", "hl", "rxmap", "view", "hex" };
+    long* fields[] = { &m.nodes, &m.text, &m.hl, &m.rxmap, &m.view, &m.hex };
+    char msg[sizeof(E.statusmsg)];
+    char b[24];
+    unsigned int i;
+
+    editorMemoryUsage(&m);
+    editorFormatBytes(m.total, b, sizeof(b));
+    int len = snprintf(msg, sizeof(msg), "mem %s:", b);
+
+    // only what there is (which depends on the mode), as much of it as fits in the message
+    for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    {
+        if (*fields[i] == 0) continue;
+
+        editorFormatBytes(*fields[i], b, sizeof(b));
+        if (len + 2 + strlen(names[i]) + strlen(b) >= sizeof(msg)) break;
+        len += snprintf(&msg[len], sizeof(msg) - len, " %s %s", names[i], b);
+    }
+
+    editorSetStatusMessage("%s", msg);
+}
+
+
+/*** editor operations (no worries about details of modifying an erow) ***/
+// give the row the cursor is on a gap to type into (see editorRowOpenGap()), closing the one on any other row
+void editorOpenGap()
+{
+    erow* row = editorRow(E.buf->cy);
+
+    // (a row that was inline when the cursor got to it gets its gap once it has grown onto the heap)
+    if (E.buf->gap_row == E.buf->cy && row->storage == ROW_GAP) return;
+
+    if (E.buf->gap_row != -1 && E.buf->gap_row != E.buf->cy) editorRowCloseGap(editorRow(E.buf->gap_row));
+    E.buf->gap_row = E.buf->cy;
+    editorRowOpenGap(row);
+}
+
+// called before every frame: the gap only stays open while the cursor is on its row
+void editorCloseGapIfLeft()
+{
+    if (E.buf->gap_row == -1 || E.buf->gap_row == E.buf->cy) return;
+
+    if (E.buf->gap_row < E.buf->numrows) editorRowCloseGap(editorRow(E.buf->gap_row));
+    E.buf->gap_row = -1;
+}
+
+/*
+  If E.buf->cy == E.buf->numrows, then the cursor is on the tilde line after the end of the file,
+  so we need to append a new row to the file before inserting a character there.
   After inserting a character, we move the cursor forward so that the next character the user inserts will go after the character just inserted.
 */
 void editorInsertChar(int c)
 {
-    if (E.cy == E.numrows)
-        editorInsertRow(E.numrows, "", 0);
+    if (E.buf->cy == E.buf->numrows)
+        editorInsertRow(E.buf->numrows, "", 0);
 
-    editorRowInsertChar(&E.row[E.cy], E.cx, c);
-    E.cx++;
+    editorOpenGap();
+    E.buf->cx += editorRowInsertChar(editorRow(E.buf->cy), E.buf->cx, c);
 }
 
 /*
@@ -412,215 +4412,778 @@ void editorInsertChar(int c)
   Then we reassign the row pointer, because editorInsertRow() calls realloc(), which might move memory around on us and invalidate the pointer.
   Then we truncate the current row’s contents by setting its size to the position of the cursor, and we call editorUpdateRow() on the truncated row.
 
-  In both cases, we increment E.cy, and set E.cx to 0 to move the cursor to the beginning of the row
+  In both cases, we increment E.buf->cy, and set E.buf->cx to 0 to move the cursor to the beginning of the row
 */
 void editorInsertNewline()
 {
-    if (E.cx == 0)
+    if (E.buf->cx == 0)
     {
-        editorInsertRow(E.cy, "", 0);
+        editorInsertRow(E.buf->cy, "", 0);
     } 
     else
     {
-        erow* row = &E.row[E.cy];
-        editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-        row = &E.row[E.cy];
-        row->size = E.cx;
-        row->chars[row->size] = '\0';
-        editorUpdateRow(row);
+        erow* row = editorRow(E.buf->cy);
+
+        // copy out the part that moves to the new row first: editorInsertRow() moves the rows of its leaf (an inline row's contents are part of it),
+        // and long rows and the row being edited aren't in one piece anyway
+        long len = row->size - E.buf->cx;
+        char* tail = malloc(len + 1);
+
+        editorRowCopy(row, E.buf->cx, len, tail);
+        editorInsertRow(E.buf->cy + 1, tail, len);
+        free(tail);
+
+        row = editorRow(E.buf->cy);
+        editorRowTruncate(row, E.buf->cx);
     }
 
-    E.cy++;
-    E.cx = 0;
+    E.buf->cy++;
+    E.buf->cx = 0;
 }
 
 /*
   If the cursor’s past the end of the file, then there is nothing to delete, and we return
   Otherwise, we get the erow the cursor is on, and if there is a character to the left of the cursor,
-  we delete it and move the cursor one to the left.
+  we delete it and move the cursor to where it started (it can be more than one byte).
 */
 void editorDelChar() 
 {
-    if (E.cy == E.numrows) return;
-    if (E.cx == 0 && E.cy == 0) return;
+    if (E.buf->cy == E.buf->numrows) return;
+    if (E.buf->cx == 0 && E.buf->cy == 0) return;
 
-    erow* row = &E.row[E.cy];
+    erow* row = editorRow(E.buf->cy);
 
-    if (E.cx > 0) 
+    if (E.buf->cx > 0) 
     {
-        editorRowDelChar(row, E.cx - 1);
-        E.cx--;
+        editorOpenGap();
+        E.buf->cx = editorRowCharStart(row, E.buf->cx - 1);
+        editorRowDelChar(row, E.buf->cx);
     }
     else
     {
         /*
           If the cursor is at the beginning of the first line, then there’s nothing to do, so we return immediately.
-          Otherwise, if we find that E.cx == 0, we call editorRowAppendString() and then editorDelRow() as we planned.
-          row points to the row we are deleting, so we append row->chars to the previous row, and then delete the row that E.cy is on.
-          We set E.cx to the end of the contents of the previous row before appending to that row.
+          Otherwise, if we find that E.buf->cx == 0, we call editorRowAppendString() and then editorDelRow() as we planned.
+          row points to the row we are deleting, so we append its contents to the previous row, and then delete the row that E.buf->cy is on.
+          We set E.buf->cx to the end of the contents of the previous row before appending to that row.
           That way, the cursor will end up at the point where the two lines joined
         */
-        E.cx = E.row[E.cy - 1].size;
-        editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
-        editorDelRow(E.cy);
-        E.cy--;
+        E.buf->cx = editorRow(E.buf->cy - 1)->size;
+
+        char* s = malloc(row->size + 1);
+
+        editorRowCopy(row, 0, row->size, s);
+        editorRowAppendString(editorRow(E.buf->cy - 1), s, row->size);
+        free(s);
+
+        editorDelRow(E.buf->cy);
+        E.buf->cy--;
+    }
+}
+
+// show the cursor in the middle of the screen, rather than at its edge (after jumping to it)
+void editorCenterCursor()
+{
+    E.buf->rowoff = E.buf->cy - E.screenrows / 2;
+    if (E.buf->rowoff < 0) E.buf->rowoff = 0;
+}
+
+// put the cursor on row 'at' (clamped to the file), at screen column rx (or as near as the row allows)
+void editorJumpTo(long at, long rx)
+{
+    if (E.buf->readonly) editorViewScan(at + E.screenrows, -1); // -R: rows are only known as far as they were scanned
+    if (at > E.buf->numrows) at = E.buf->numrows;
+    if (at < 0) at = 0;
+
+    E.buf->cy = at;
+    E.buf->cx = (at < E.buf->numrows) ? editorRowRxToCx(editorRow(at), rx) : 0;
+}
+
+// PAGE_UP/PAGE_DOWN: the screen moves a page, and the cursor with it (one jump, not a page of cursor moves)
+void editorPage(int dir)
+{
+    long rx = (E.buf->cy < E.buf->numrows) ? editorRowCxToRx(editorRow(E.buf->cy), E.buf->cx) : E.buf->cx;
+
+    editorJumpTo(E.buf->cy + dir * E.screenrows, rx);
+
+    E.buf->rowoff += dir * E.screenrows;
+    if (E.buf->rowoff > E.buf->cy) E.buf->rowoff = E.buf->cy;
+    if (E.buf->rowoff < 0) E.buf->rowoff = 0;
+}
+
+// Ctrl-Home/Ctrl-End
+void editorJumpToEnd(int end)
+{
+    if (!end)
+    {
+        editorJumpTo(0, 0);
+        return;
+    }
+
+    if (E.buf->readonly) editorViewScan(-1, E.buf->view.size); // the whole file has to be scanned to know where its last line is
+    editorJumpTo(E.buf->numrows > 0 ? E.buf->numrows - 1 : 0, 0);
+    if (E.buf->cy < E.buf->numrows) E.buf->cx = editorRow(E.buf->cy)->size;
+}
+
+// Ctrl-G: jump to a line number, a percentage of the file (with '%'), or (starting with '@') to a byte offset into it.
+// Any of them is a walk down the row tree.
+// The byte offset is into the text as it's saved, with one '\n' per line: the '\r's read from a CRLF file aren't counted
+// (rows don't remember them). With -R it's into the file itself, which is what's mapped.
+void editorGoto()
+{
+    char* query = editorPrompt(E.buf->hexmode ? "Go to offset (0x for hex, or N%%): %s" : "Go to line (or N%%, @byte offset): %s");
+    if (query == NULL) return;
+
+    char* end;
+    double percent = strtod(query, &end);
+    long start;
+
+    if (end != query && *end == '%')
+    {
+        if (percent < 0) percent = 0;
+        if (percent > 100) percent = 100;
+
+        if (E.buf->hexmode)
+            editorHexSeek(E.buf->hex.size > 0 ? (long)((E.buf->hex.size - 1) * percent / 100) : 0);
+        else if (E.buf->readonly)
+            editorJumpTo(editorRowAtOffset((long)(E.buf->view.size * percent / 100), &start), 0); // -R: the line count isn't known, the size is
+        else
+            editorJumpTo(E.buf->numrows > 0 ? (long)((E.buf->numrows - 1) * percent / 100) : 0, 0);
+    }
+    else if (E.buf->hexmode)
+    {
+        editorHexSeek(strtol((query[0] == '@') ? &query[1] : query, NULL, 0));
+    }
+    else if (query[0] == '@')
+    {
+        long offset = atol(&query[1]);
+        long at = editorRowAtOffset(offset < 0 ? 0 : offset, &start);
+        long rx = 0;
+
+        if (at < E.buf->numrows)
+        {
+            erow* row = editorRow(at);
+            long col = offset - start;
+
+            rx = editorRowCxToRx(row, (col >= row->size) ? row->size : editorRowCharStart(row, col));
+        }
+        editorJumpTo(at, rx);
+    }
+    else
+    {
+        long line = atol(query);
+
+        if (E.buf->readonly) editorViewScan(line - 1, -1);
+        if (line > E.buf->numrows) line = E.buf->numrows;
+        if (line < 1) line = 1;
+
+        editorJumpTo(line - 1, 0);
+    }
+
+    free(query);
+    editorCenterCursor();
+}
+
+/*
+  Ctrl-F: find the next match of a string after the cursor, wrapping around at the end of the file.
+  Rows that aren't in one piece (long rows, the row being edited) are copied out to be searched.
+  With -R the map is searched instead, without decoding any rows, and with -x the bytes (editorHexFind()).
+*/
+void editorFind()
+{
+    char* query = editorPrompt("Search: %s (ESC to cancel)");
+    if (query == NULL) return;
+
+    long len = strlen(query);
+    int found = 0;
+    long n;
+
+    int rows = !E.buf->readonly && !E.buf->hexmode; // -R and -x have the file mapped, and search that
+
+    if (E.buf->hexmode) found = editorHexFind(query, len);
+    else if (E.buf->readonly) found = editorViewFind(query, len);
+
+    // the cursor's row is looked at twice: after the cursor first, and from its start again after wrapping around
+    for (n = 0; rows && !found && n <= E.buf->numrows && E.buf->numrows > 0; n++)
+    {
+        long at = (E.buf->cy + n) % E.buf->numrows;
+        long from = (n == 0) ? E.buf->cx + 1 : 0;
+        erow* row = editorRow(at);
+
+        if (from > row->size) continue;
+
+        char* chars = editorRowChars(row);
+        char* copy = NULL;
+
+        if (chars == NULL)
+        {
+            chars = copy = malloc(row->size + 1);
+            editorRowCopy(row, 0, row->size, copy);
+        }
+
+        char* match = memmem(&chars[from], row->size - from, query, len);
+
+        if (match)
+        {
+            E.buf->cy = at;
+            E.buf->cx = match - chars;
+            found = 1;
+        }
+        free(copy);
+    }
+
+    if (found) editorCenterCursor();
+    else editorSetStatusMessage("Not found: %.40s", query);
+
+    free(query);
+}
+
+
+/*** file IO ***/
+/*
+  Write every row to fd, with a newline after each one.
+  The rows are copied into a WRITE_BUF_SIZE buffer and written out whenever it fills up, rather than joined into one string first:
+  a file of several GB doesn't need a second copy of itself in memory to be saved.
+  write() can write less than it was asked to (and never more than about 2 GB at once), so every buffer is written in a loop.
+  Returns -1 on error (errno is set), 0 otherwise.
+  Frames are written to the terminal with editorWriteAll() too: a big one can be taken only in part, and a terminal
+  that's non-blocking says EAGAIN until there's room for the rest.
+*/
+int editorWriteAll(int fd, const char* buf, long len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+
+        if (n == -1)
+        {
+            struct pollfd out = { fd, POLLOUT, 0 };
+
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN && poll(&out, 1, -1) != -1) continue;
+            return -1;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+int editorWriteRows(int fd)
+{
+    char* buf = malloc(WRITE_BUF_SIZE);
+    long used = 0;
+    int failed = 0;
+    long j;
+
+    if (buf == NULL) return -1;
+
+    for (j = 0; j < E.buf->numrows && !failed; j++)
+    {
+        erow* row = editorRow(j);
+        long at = 0;
+
+        // a row can be bigger than the buffer (long rows are copied over a piece at a time)
+        while (at <= row->size && !failed)
+        {
+            long n = row->size - at;
+
+            if (n > WRITE_BUF_SIZE - used - 1) n = WRITE_BUF_SIZE - used - 1;
+
+            editorRowCopy(row, at, n, &buf[used]);
+            used += n;
+            at += n;
+
+            if (at == row->size)
+            {
+                buf[used++] = '\n';
+                at++;
+            }
+
+            if (used >= WRITE_BUF_SIZE - 1)
+            {
+                failed = (editorWriteAll(fd, buf, used) == -1); // the '\n' may be in it: at alone can't tell
+                used = 0;
+            }
+        }
+    }
+
+    int ret = failed ? -1 : editorWriteAll(fd, buf, used);
+
+    free(buf);
+    return ret;
+}
+
+// for opening and reading file from disk
+void editorOpen(char* filename)
+{
+    // drop whatever was open before
+    editorFreeRows();
+
+    // get file name
+    free(E.buf->filename);
+    E.buf->filename = strdup(filename); // get copy of filename
+
+    if (E.buf->hexmode)
+    {
+        editorHexOpen(filename);
+        editorWatchStart(filename, NULL, E.buf->hex.size, 0);
+        return;
+    }
+
+    if (E.buf->readonly)
+    {
+        editorViewOpen(filename);
+        editorWatchStart(filename, NULL, E.buf->view.size, 0);
+        return;
+    }
+
+    editorSelectSyntaxHighlight();
+
+    FILE* fp = fopen(filename, "r");
+    if (!fp) die("fopen");
+
+    struct stat st; // what the file looks like before it's read (see editorWatchStart())
+    fstat(fileno(fp), &st);
+
+    char* line = NULL;
+    size_t linecap = 0;
+    ssize_t linelen;
+    int partial = 0; // last line has no newline at its end
+
+    // getline return -1 when it gets to the end of the file (as there's no more line to read)
+    while ((linelen = getline(&line, &linecap, fp)) != -1)
+    {
+        partial = (line[linelen - 1] != '\n');
+
+        while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
+            linelen--;
+
+        editorInsertRow(E.buf->numrows, line, linelen);
+    }
+
+    free(line);
+    editorWatchStart(filename, &st, ftell(fp), partial); // from exactly where reading stopped
+    fclose(fp);
+    E.buf->dirty = 0;
+}
+
+/*
+  New file: prompt for "Save as: "
+  else: 
+  Call editorWriteRows() to write the rows to the path in E.buf->filename.
+  Tell open() we want to create a new file if it doesn’t already exist (O_CREAT), and we want to open it for reading and writing (O_RDWR).
+  Because we used the O_CREAT flag, we have to pass an extra argument containing the mode (the permissions) the new file should have
+
+  ftruncate() sets the file’s size to the specified length. 
+  If the file is larger than that, it will cut off any data at the end of the file to make it that length. 
+  If the file is shorter, it will add 0 bytes at the end to make it that length.
+
+  open() and ftruncate() both return -1 on error.
+  editorWriteRows() keeps writing until everything is written, or returns -1 if a write fails.
+  Whether or not an error occurred, we ensure that the file is closed.
+*/
+void editorSave()
+{
+    if (E.buf->hexmode)
+    {
+        editorHexSave();
+        return;
+    }
+
+    if (E.buf->filename == NULL)
+    {
+        E.buf->filename = editorPrompt("Save as: %s (ESC to cancel)");
+
+        if (E.buf->filename == NULL) 
+        {
+            editorSetStatusMessage("Save aborted");
+            return;
+        }
+
+        editorSelectSyntaxHighlight();
+    }
+
+    editorTreeSettle();
+
+    long len = E.buf->rows ? E.buf->rows->numbytes : 0; // the row tree keeps count (a newline after every row included)
+    int fd = open(E.buf->filename, O_RDWR | O_CREAT, 0644); // 0644: the standard permissions for text file
+    
+    if (fd != -1) 
+    {
+        if (ftruncate(fd, len) != -1) 
+        {
+            if (editorWriteRows(fd) == 0) 
+            {
+                close(fd);
+                E.buf->dirty = 0;
+                editorWatchStart(E.buf->filename, NULL, len, 0); // what the file looks like now is ours (it may be a new file, too)
+                editorSetStatusMessage("%ld bytes written to disk", len);
+                return;
+            }
+        }
+        
+        close(fd);
+    }
+
+    editorSetStatusMessage("Save failed! I/O error: %s", strerror(errno));
+}
+
+
+/*** buffers ***/
+/*
+  Every open file is a buffer of its own (struct editorBuffer): its rows, how it's opened (-R, -x, -f), its watch and
+  its cursor and scroll position. E.buf is the one being edited, and everything else in E is what they share:
+  - the screen, and its cache of what's on it: only the lines that differ are drawn after a switch
+  - the highlighter thread: the batch that's running is cancelled on a switch, and whatever it still hands back is
+    dropped because row versions come from one clock (E.version_clock), so they never match another buffer's rows
+  - spare arena slabs (see editorArenaRelease())
+  Switching is just pointing E.buf at another buffer, so nothing is freed or redone: the rows, with their render and
+  highlight caches, are all as they were left. Every buffer's file is watched (see editorWaitForInput()).
+*/
+// a new, empty buffer at the end of the list (not switched to)
+struct editorBuffer* editorBufferNew()
+{
+    struct editorBuffer* b = calloc(1, sizeof(struct editorBuffer));
+    if (b == NULL) die("calloc");
+
+    b->readonly = E.open_readonly;
+    b->follow = E.open_follow;
+    b->hexmode = E.open_hexmode;
+    b->gap_row = -1;
+    b->hex.fd = -1;
+    b->watch.inotify = -1;
+    b->watch.wd = -1;
+    b->watch.fd = -1;
+
+    if (E.numbuffers == E.buffercap)
+    {
+        E.buffercap = E.buffercap ? E.buffercap * 2 : 8;
+        E.buffers = realloc(E.buffers, sizeof(struct editorBuffer*) * E.buffercap);
+        if (E.buffers == NULL) die("realloc");
     }
+    E.buffers[E.numbuffers++] = b;
+
+    return b;
+}
+
+// make buffer i the one being edited
+void editorBufferSelect(int i)
+{
+    if (E.highlighter.inflight) __atomic_store_n(&E.highlighter.inflight->cancel, 1, __ATOMIC_RELAXED);
+
+    E.current = i;
+    E.buf = E.buffers[i];
+    editorSetStatusMessage("Buffer %d/%d: %s", i + 1, E.numbuffers, E.buf->filename ? E.buf->filename : "[No Name]");
+}
+
+// next (dir 1) or previous (dir -1) buffer, going round
+void editorBufferSwitch(int dir)
+{
+    if (E.numbuffers < 2)
+    {
+        editorSetStatusMessage("No other buffers (Ctrl-O opens a file)");
+        return;
+    }
+
+    editorBufferSelect((E.current + dir + E.numbuffers) % E.numbuffers);
+}
+
+// open a file in a buffer of its own (or go to the buffer it's already open in)
+void editorBufferOpen(char* filename)
+{
+    int i;
+
+    for (i = 0; i < E.numbuffers; i++)
+    {
+        if (E.buffers[i]->filename && strcmp(E.buffers[i]->filename, filename) == 0)
+        {
+            editorBufferSelect(i);
+            return;
+        }
+    }
+
+    // the empty buffer hexa starts with is used for the first file
+    if (E.buf->filename || E.buf->numrows > 0 || E.buf->dirty)
+    {
+        editorBufferNew();
+        editorBufferSelect(E.numbuffers - 1);
+    }
+
+    editorOpen(filename);
+}
+
+// close the buffer being edited (unsaved changes are lost), going to the one before it; the last one leaves an empty one
+void editorBufferClose()
+{
+    struct editorBuffer* b = E.buf;
+    int i;
+
+    if (E.highlighter.inflight) __atomic_store_n(&E.highlighter.inflight->cancel, 1, __ATOMIC_RELAXED);
+
+    if (b->hexmode)
+        editorHexClose();
+    else if (b->readonly)
+        editorViewClose();
+    else
+        editorFreeRows(); // (and the arena's slabs)
+    editorWatchStop();
+    free(b->filename);
+    free(b);
+
+    for (i = E.current; i < E.numbuffers - 1; i++) E.buffers[i] = E.buffers[i + 1];
+    E.numbuffers--;
+
+    if (E.numbuffers == 0) editorBufferNew();
+    editorBufferSelect(E.current > 0 ? E.current - 1 : 0);
 }
 
+// how many buffers have unsaved changes
+int editorBuffersDirty()
+{
+    int i, n = 0;
 
-/*** file IO ***/
-/*
-  First we add up the lengths of each row of text, adding 1 to each one for the newline character we’ll add to the end of each line.
-  We save the total length into buflen, to tell the caller how long the string is.
-  
-  Then, after allocating the required memory, we loop through the rows, and memcpy() the contents of each row to the end of the buffer,
-  appending a newline character after each row.
+    for (i = 0; i < E.numbuffers; i++) n += (E.buffers[i]->dirty != 0);
+    return n;
+}
 
-  We return buf, expecting the caller to free() the memory.
-*/
-char* editorRowsToString(int* buflen)
+// Ctrl-O
+void editorBufferPrompt()
 {
-    int totlen = 0;
-    int j;
+    char* filename = editorPrompt("Open: %s (ESC to cancel)");
+    if (filename == NULL) return;
 
-    for (j = 0; j < E.numrows; j++)
-        totlen += E.row[j].size + 1;
+    if (access(filename, R_OK) == -1)
+        editorSetStatusMessage("Can't open %s: %s", filename, strerror(errno));
+    else
+        editorBufferOpen(filename);
 
-    *buflen = totlen;
-    char* buf = malloc(totlen);
-    char* p = buf;
+    free(filename);
+}
 
-    for (j = 0; j < E.numrows; j++)
-    {
-        memcpy(p, E.row[j].chars, E.row[j].size);
-        p += E.row[j].size;
-        *p = '\n';
-        p++;
-    }
-    
-    return buf;
+// the watch of a buffer has news: look at it as that buffer (returns 1 if the screen has to be drawn again)
+int editorBufferWatchPoll(struct editorBuffer* b)
+{
+    struct editorBuffer* current = E.buf;
+    int changed;
+
+    E.buf = b;
+    changed = editorWatchPoll();
+    E.buf = current;
+
+    return changed && b == current;
 }
 
-// for opening and reading file from disk
-void editorOpen(char* filename)
+
+/*** output ***/
+// check if cursor moved outside of screen, if so, adjust E.buf->rowoff so that cursor is inside visible window
+void editorScroll() 
 {
-    // get file name
-    free(E.filename);
-    E.filename = strdup(filename); // get copy of filename
+    // -R: the file is only scanned as far as it was looked at, keep the rows a screen or two ahead of the cursor known
+    if (E.buf->readonly && !E.buf->hexmode) editorViewScan(E.buf->cy + 2 * E.screenrows, -1);
 
-    FILE* fp = fopen(filename, "r");
-    if (!fp) die("fopen");
+    E.buf->rx = E.buf->cx;
 
-    char* line = NULL;
-    size_t linecap = 0;
-    ssize_t linelen;
+    if (E.buf->hexmode)
+        E.buf->rx = editorHexColumn();
+    else if (E.buf->cy < E.buf->numrows)
+        E.buf->rx = editorRowCxToRx(editorRow(E.buf->cy), E.buf->cx);
 
-    // getline return -1 when it gets to the end of the file (as there's no more line to read)
-    while ((linelen = getline(&line, &linecap, fp)) != -1)
-    {
-        while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
-            linelen--;
+    // check if cursor is above the visible window
+    if (E.buf->cy < E.buf->rowoff)
+        E.buf->rowoff = E.buf->cy;
 
-        editorInsertRow(E.numrows, line, linelen);
-    }
+    // check if cursor is past the bottom of the visible window
+    if (E.buf->cy >= E.buf->rowoff + E.screenrows)
+        E.buf->rowoff = E.buf->cy - E.screenrows + 1; // since E.buf->rowoff refers to top of the screen
 
-    free(line);
-    fclose(fp);
-    E.dirty = 0;
+    // check if cursor is to the left of the visible window
+    if (E.buf->rx < E.buf->coloff)
+        E.buf->coloff = E.buf->rx;
+
+    // check if cursor is to the right of the visible window
+    if (E.buf->rx >= E.buf->coloff + E.screencols)
+        E.buf->coloff = E.buf->rx - E.screencols + 1;
 }
 
-/*
-  New file: prompt for "Save as: "
-  else: 
-  Call editorRowsToString(), and write() the string to the path in E.filename.
-  Tell open() we want to create a new file if it doesn’t already exist (O_CREAT), and we want to open it for reading and writing (O_RDWR).
-  Because we used the O_CREAT flag, we have to pass an extra argument containing the mode (the permissions) the new file should have
+// where drawing a row is at, so a row can be drawn in pieces (one per chunk of a long row)
+struct drawState
+{
+    long rx; // render column of the next character
+    long coloff; // first column on screen
+    long end; // column right after the last one on screen
+    int color; // color currently set on the terminal (-1 means default text color)
+};
 
-  ftruncate() sets the file’s size to the specified length. 
-  If the file is larger than that, it will cut off any data at the end of the file to make it that length. 
-  If the file is shorter, it will add 0 bytes at the end to make it that length.
+void editorDrawColor(struct abuf* ab, int color)
+{
+    char buf[16];
+    int clen = (color == -1) ? snprintf(buf, sizeof(buf), "\x1b[39m") : snprintf(buf, sizeof(buf), "\x1b[%dm", color);
 
-  open() and ftruncate() both return -1 on error.
-  We expect write() to return the number of bytes we told it to write. 
-  Whether or not an error occurred, we ensure that the file is closed and the memory that buf points to is freed.
-*/
-void editorSave()
+    abAppend(ab, buf, clen);
+}
+
+// draw the part of s (len bytes, hl has the highlight of each of them or is NULL) that's on screen
+void editorDrawSpan(struct abuf* ab, struct drawState* ds, const char* s, int len, const unsigned char* hl)
 {
-    if (E.filename == NULL)
+    int j = 0;
+
+    while (j < len && ds->rx < ds->end)
     {
-        E.filename = editorPrompt("Save as: %s (ESC to cancel)");
+        int color = (!hl || hl[j] == HL_NORMAL) ? -1 : editorSyntaxToColor(hl[j]);
 
-        if (E.filename == NULL) 
+        if (color != ds->color)
         {
-            editorSetStatusMessage("Save aborted");
-            return;
+            editorDrawColor(ab, color);
+            ds->color = color;
         }
-    }
 
-    int len;
-    char* buf = editorRowsToString(&len);
-    int fd = open(E.filename, O_RDWR | O_CREAT, 0644); // 0644: the standard permissions for text file
-    
-    if (fd != -1) 
-    {
-        if (ftruncate(fd, len) != -1) 
+        // append the whole run of printable ASCII characters with the same highlight at once
+        int run = editorAsciiRun(&s[j], len - j);
+        int k;
+
+        if (run > ds->end - ds->rx) run = ds->end - ds->rx;
+        for (k = 0; k < run && s[j + k] >= ' ' && s[j + k] != 0x7F && (!hl || hl[j + k] == hl[j]); k++);
+
+        if (k > 0)
         {
-            if (write(fd, buf, len) == len) 
-            {
-                close(fd);
-                free(buf);
-                E.dirty = 0;
-                editorSetStatusMessage("%d bytes written to disk", len);
-                return;
-            }
+            abAppend(ab, &s[j], k);
+            ds->rx += k;
+            j += k;
+            continue;
         }
-        
-        close(fd);
+
+        int cp;
+        int n = editorDecodeChar(&s[j], len - j, &cp);
+        int w = editorCharWidth(cp, ds->rx);
+
+        if (cp == '\t' || ds->rx < ds->coloff || ds->rx + w > ds->end)
+        {
+            // tabs, and wide characters cut in half by the edge of the screen, are drawn as spaces
+            long from = (ds->rx < ds->coloff) ? ds->coloff : ds->rx;
+            long to = (ds->rx + w > ds->end) ? ds->end : ds->rx + w;
+
+            for (; from < to; from++) abAppend(ab, " ", 1);
+        }
+        else if (editorWidthClass(cp) == WC_NONPRINT)
+        {
+            // control characters are displayed as an inverted '@', 'A', 'B', ... (or '?' if not printable that way)
+            char sym = (cp >= 0 && cp <= 26) ? '@' + cp : '?';
+            abAppend(ab, "\x1b[7m", 4);
+            abAppend(ab, &sym, 1);
+            abAppend(ab, "\x1b[m", 3);
+
+            // '[m' turned off all formatting, so restore the current color
+            if (ds->color != -1) editorDrawColor(ab, ds->color);
+        }
+        else
+        {
+            abAppend(ab, &s[j], n);
+        }
+
+        ds->rx += w;
+        j += n;
     }
+}
 
-    free(buf);
-    editorSetStatusMessage("Save failed! I/O error: %s", strerror(errno));
+// draw the columns [coloff, coloff + screencols) of a row
+void editorDrawRow(struct abuf* ab, erow* row)
+{
+    if (E.buf->coloff >= row->rsize) return;
+
+    long cx = editorRowRxToCx(row, E.buf->coloff);
+    struct drawState ds = { editorRowCxToRx(row, cx), E.buf->coloff, E.buf->coloff + E.screencols, -1 }; // rx can be left of coloff, if a tab or wide character covers it
+
+    int has_hl = (E.buf->syntax && row->hl && row->hl_current); // highlighter may not have caught up with this row yet
+
+    // one piece at a time: normal rows are one, the row being edited two (around the gap), long rows as many chunks as are on screen
+    while (cx < row->size && ds.rx < ds.end)
+    {
+        long start, len;
+        const char* s = editorRowSegment(row, cx, &start, &len);
+
+        editorDrawSpan(ab, &ds, &s[cx - start], len - (cx - start), has_hl ? &row->hl[cx] : NULL);
+        cx = start + len;
+    }
+
+    if (ds.color != -1) abAppend(ab, "\x1b[39m", 5);
 }
 
+/*
+  Only lines that differ from what the terminal already shows are sent (each line is drawn, hashed, and dropped again
+  if the hash matches the one drawn there last time).
+  When the screen scrolled by less than a page, the terminal scrolls the text area itself (a scroll region and
+  "\x1b[nS" or "\x1b[nT"), so only the lines that came into view are new.
+*/
+// throw away what's known about the screen: the next frame draws all of it (Ctrl-L, and when the size changes)
+void editorScreenInvalidate()
+{
+    if (E.screen.lines) memset(E.screen.lines, 0, E.screen.rows * sizeof(unsigned long));
+}
 
-/*** output ***/
-// check if cursor moved outside of screen, if so, adjust E.rowoff so that cursor is inside visible window
-void editorScroll() 
+// scroll what the terminal shows (and what's known about it) to where E.buf->rowoff is
+void editorScreenScroll(struct abuf* ab)
 {
-    E.rx = E.cx;
+    struct editorScreen* sc = &E.screen;
+    long d = E.buf->rowoff - sc->rowoff;
+    char buf[32];
 
-    if (E.cy < E.numrows)
-        E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+    if (sc->rows != E.screenrows || sc->cols != E.screencols)
+    {
+        sc->lines = realloc(sc->lines, E.screenrows * sizeof(unsigned long));
+        if (sc->lines == NULL) die("realloc");
 
-    // check if cursor is above the visible window
-    if (E.cy < E.rowoff)
-        E.rowoff = E.cy;
+        sc->rows = E.screenrows;
+        sc->cols = E.screencols;
+        editorScreenInvalidate();
+    }
+    else if (d != 0 && d > -sc->rows && d < sc->rows)
+    {
+        int n = (d > 0) ? d : -d;
+        int len = snprintf(buf, sizeof(buf), "\x1b[1;%dr\x1b[%d%c\x1b[r", sc->rows, n, (d > 0) ? 'S' : 'T');
 
-    // check if cursor is past the bottom of the visible window
-    if (E.cy >= E.rowoff + E.screenrows)
-        E.rowoff = E.cy - E.screenrows + 1; // since E.rowoff refers to top of the screen
+        abAppend(ab, buf, len);
 
-    // check if cursor is to the left of the visible window
-    if (E.rx < E.coloff)
-        E.coloff = E.rx;
+        if (d > 0)
+        {
+            memmove(sc->lines, &sc->lines[n], (sc->rows - n) * sizeof(unsigned long));
+            memset(&sc->lines[sc->rows - n], 0, n * sizeof(unsigned long));
+        }
+        else
+        {
+            memmove(&sc->lines[n], sc->lines, (sc->rows - n) * sizeof(unsigned long));
+            memset(sc->lines, 0, n * sizeof(unsigned long));
+        }
+    }
+    else if (d != 0)
+    {
+        editorScreenInvalidate(); // a page or more: nothing on screen stays
+    }
 
-    // check if cursor is to the right of the visible window
-    if (E.rx >= E.coloff + E.screencols)
-        E.coloff = E.rx - E.screencols + 1;
+    sc->rowoff = E.buf->rowoff;
 }
 
 // handle drawing each row of buffer of text being edited
 void editorDrawRows(struct abuf* ab)
 {
     int y;
+    char buf[32];
+
+    editorScreenScroll(ab);
 
     for (y = 0; y < E.screenrows; y++) 
     {
-        int filerow = y + E.rowoff; // for displaying the row of the file at y position
+        long filerow = y + E.buf->rowoff; // for displaying the row of the file at y position
+        int at = ab->len; // where the line starts, to drop it again if the terminal shows it already
 
-        if (filerow >= E.numrows)
+        abAppend(ab, buf, snprintf(buf, sizeof(buf), "\x1b[%d;1H", y + 1));
+        int text = ab->len;
+
+        if (filerow >= E.buf->numrows)
         {
-            if (E.numrows == 0 && y == E.screenrows / 3)
+            if (E.buf->numrows == 0 && y == E.screenrows / 3)
             {
                 char welcome[80];
                 int welcomelen = snprintf(welcome, sizeof(welcome), "Hexa - Version %s", VERSION);
@@ -642,24 +5205,30 @@ void editorDrawRows(struct abuf* ab)
                 abAppend(ab, "~", 1);
             }
         }
+        else if (E.buf->hexmode)
+        {
+            editorHexDrawRow(ab, filerow);
+        }
         else 
         {
-            // subtract the number of characters that are to the left of the offset from the length of the row
-            int len = E.row[filerow].rsize - E.coloff;
-            if (len < 0) len = 0;
-            if (len > E.screencols) len = E.screencols;
-            abAppend(ab, &E.row[filerow].render[E.coloff], len); // display characters in 'render'
+            editorDrawRow(ab, editorRow(filerow));
         }
 
         abAppend(ab, "\x1b[K", 3);
 
-        abAppend(ab, "\r\n", 2);
+        unsigned long h = editorHashBytes(HASH_BASIS, &ab->b[text], ab->len - text) | 1; // never 0 (unknown)
+        if (E.screen.lines[y] == h)
+            ab->len = at;
+        else
+            E.screen.lines[y] = h;
     }
+
+    abAppend(ab, buf, snprintf(buf, sizeof(buf), "\x1b[%d;1H", E.screenrows + 1)); // the status bar goes after the text
 }
 
 // escape sequence '[7m' switches to inverted colors, '[m' switches back to normal formatting
 /*
-  The current line is stored in E.cy, which we add 1 to since E.cy is 0-indexed.
+  The current line is stored in E.buf->cy, which we add 1 to since E.buf->cy is 0-indexed.
 
   After printing the first status string, we want to keep printing spaces until we get to the point where 
   if we printed the second status string, it would end up against the right edge of the screen.
@@ -671,10 +5240,13 @@ void editorDrawStatusBar(struct abuf* ab)
 {
     abAppend(ab, "\x1b[7m", 4);
 
-    // state of E.dirty is (modified) in status bar
-    char status[80], rstatus[80];
-    int len = snprintf(status, sizeof(status), "%.20s - %d lines %s", E.filename ? E.filename : "[No Name]", E.numrows, E.dirty ? "(modified)" : "");
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%d/%d", E.cy + 1, E.numrows);
+    // state of E.buf->dirty is (modified) in status bar
+    char status[80], rstatus[80], tag[32] = "";
+    if (E.numbuffers > 1) snprintf(tag, sizeof(tag), " [%d/%d]", E.current + 1, E.numbuffers);
+    int len = snprintf(status, sizeof(status), "%.20s%s - %ld%s lines %s", E.buf->filename ? E.buf->filename : "[No Name]", tag, E.buf->numrows,
+                       (E.buf->readonly && E.buf->view.scanned < E.buf->view.size) ? "+" : "", E.buf->readonly ? "(read-only)" : E.buf->dirty ? "(modified)" : "");
+    int rlen = E.buf->hexmode ? snprintf(rstatus, sizeof(rstatus), "hex | 0x%lx/0x%lx", E.buf->cy * HEX_ROW_BYTES + E.buf->cx, E.buf->hex.size)
+                         : snprintf(rstatus, sizeof(rstatus), "%s | %ld/%ld", E.buf->syntax ? E.buf->syntax->filetype : "no ft", E.buf->cy + 1, E.buf->numrows);
 
     if (len > E.screencols) len = E.screencols;
     abAppend(ab, status, len);
@@ -697,6 +5269,25 @@ void editorDrawStatusBar(struct abuf* ab)
     abAppend(ab, "\r\n", 2); // new line (for second status bar)
 }
 
+// the overlay, right-aligned after 'used' columns of message: what the last frame took (this one isn't done yet), times in ms
+void editorDrawStats(struct abuf* ab, int used)
+{
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf), "key %.2f scroll %.3f rows %.3f write %.3f %dB %.0ffps",
+        E.stats.latency * 1e3, E.stats.scroll * 1e3, E.stats.rows * 1e3, E.stats.write * 1e3, E.stats.bytes, E.stats.fps);
+    int room = E.screencols - used - 1; // a space after the message
+
+    if (len > room) len = room;
+    if (len <= 0) return;
+
+    while (used < E.screencols - len)
+    {
+        abAppend(ab, " ", 1);
+        used++;
+    }
+    abAppend(ab, buf, len);
+}
+
 /*
   Clear message bar with '[K' escape sequence
   Make sure the message will fit the width of the screen, then display the message (only if the message is less than 5 seconds old)
@@ -710,30 +5301,97 @@ void editorDrawMessageBar(struct abuf* ab)
     if (msglen > E.screencols) msglen = E.screencols;
     if (msglen && time(NULL) - E.statusmsg_time < 5)
         abAppend(ab, E.statusmsg, msglen);
+    else
+        msglen = 0;
+
+    if (E.stats.on) editorDrawStats(ab, msglen); // a message (or a prompt) comes first
+}
+
+// account for a frame written (starting at 'start', len bytes)
+void editorStatsFrame(double start, int len)
+{
+    double t = editorNow();
+
+    E.stats.write = t - start;
+    E.stats.bytes = len;
+
+    if (E.stats.key_time)
+    {
+        E.stats.latency = t - E.stats.key_time;
+        E.stats.key_time = 0;
+    }
+
+    E.stats.frames++;
+    if (t - E.stats.fps_time >= 1)
+    {
+        E.stats.fps = E.stats.frames / (t - E.stats.fps_time);
+        E.stats.frames = 0;
+        E.stats.fps_time = t;
+    }
+}
+
+// send a frame to the terminal, all at once (only counted when headless)
+void editorOutput(const char* s, int len)
+{
+    if (E.headless.on)
+    {
+        E.headless.bytes += len;
+        E.headless.frames++;
+        return;
+    }
+
+    uint64_t t = editorTraceBegin();
+
+    editorWriteAll(STDOUT_FILENO, s, len);
+    editorTraceEnd(TRACE_WRITE, t);
 }
 
 // writing an escape sequence to the terminal
 void editorRefreshScreen() 
 {
+    uint64_t span = editorTraceBegin();
+    double t = E.stats.on ? editorNow() : 0;
+
+    editorCloseGapIfLeft();
     editorScroll();
+    if (E.stats.on) E.stats.scroll = editorNow() - t;
+
+    // pick up finished highlighting and give the worker a chance to color in what's on screen before drawing it
+    editorSyntaxCollect();
+    if (editorSyntaxSchedule())
+    {
+        editorSyntaxWait();
+        editorSyntaxCollect();
+        editorSyntaxSchedule();
+    }
 
     struct abuf ab = ABUF_INIT;
 
+    if (E.sync) abAppend(&ab, SYNC_BEGIN, strlen(SYNC_BEGIN));
     abAppend(&ab, "\x1b[?25l", 6);
     abAppend(&ab, "\x1b[H", 3);
 
+    if (E.stats.on) t = editorNow();
     editorDrawRows(&ab);
+    if (E.stats.on) E.stats.rows = editorNow() - t;
     editorDrawStatusBar(&ab);
     editorDrawMessageBar(&ab);
 
     char buf[32];
-    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1); // reposition the cursor by subtracting rowoff with cy and coloff with cx
+    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (int)(E.buf->cy - E.buf->rowoff) + 1, (int)(E.buf->rx - E.buf->coloff) + 1); // reposition the cursor by subtracting rowoff with cy and coloff with cx
     abAppend(&ab, buf, strlen(buf));
 
     abAppend(&ab, "\x1b[?25h", 6);
+    if (E.sync) abAppend(&ab, SYNC_END, strlen(SYNC_END));
 
-    write(STDOUT_FILENO, ab.b, ab.len);
+    if (E.stats.on) t = editorNow();
+    editorOutput(ab.b, ab.len);
+    if (E.stats.on) editorStatsFrame(t, ab.len);
+    if (ab.len > E.frame_peak) E.frame_peak = ab.len;
     abFree(&ab);
+    E.frame_time = editorNow();
+
+    editorTraceEnd(TRACE_RENDER, span);
 }
 
 /*
@@ -758,7 +5416,7 @@ void editorSetStatusMessage(const char* fmt, ...)
   The prompt is expected to be a format string containing a %s, which is where the user’s input will be displayed.
 
   When the user presses Enter, and their input is not empty, the status message is cleared and their input is returned.
-  Otherwise, when they input a printable character, we append it to buf.
+  Otherwise, when they input a printable character, we append it to buf (as UTF-8).
   If buflen has reached the maximum capacity we allocated (stored in bufsize),
   then we double bufsize and allocate that amount of memory before appending to buf.
   We also make sure that buf ends with a \0 character,
@@ -780,7 +5438,11 @@ char* editorPrompt(char* prompt)
 
         if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE) // allow backspace in prompt
         {
-            if (buflen != 0) buf[--buflen] = '\0';
+            if (buflen != 0)
+            {
+                buflen = editorCharStart(buf, buflen, buflen - 1);
+                buf[buflen] = '\0';
+            }
         }
         else if (c == '\x1b') // When an input prompt is cancelled, we free() the buf ourselves and return NULL
         {
@@ -796,15 +5458,15 @@ char* editorPrompt(char* prompt)
                 return buf;
             }
         } 
-        else if (!iscntrl(c) && c < 128)
+        else if (c >= 32 && c != 127 && c < ARROW_LEFT)
         {
-            if (buflen == bufsize - 1)
+            if (buflen + 4 >= bufsize)
             {
                 bufsize *= 2;
                 buf = realloc(buf, bufsize);
             }
 
-            buf[buflen++] = c;
+            buflen += editorEncodeChar(c, &buf[buflen]);
             buf[buflen] = '\0';
         }
     }
@@ -814,60 +5476,90 @@ void editorMoveCursor(int key)
 {
     // check if cursor is on the line
     // If it is, then the row variable will point to the erow that the cursor is on, 
-    // and we’ll check whether E.cx is to the left of the end of that line before we allow the cursor to move to the right
-    erow* row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy]; // for limiting scrolling past the end of the current line
+    // and we’ll check whether E.buf->cx is to the left of the end of that line before we allow the cursor to move to the right
+    erow* row = (E.buf->cy >= E.buf->numrows) ? NULL : editorRow(E.buf->cy); // for limiting scrolling past the end of the current line
 
     switch (key) 
     {
         case ARROW_LEFT:
-            if (E.cx != 0)
+            if (E.buf->cx != 0)
             {
-                E.cx--;
+                // back to the start of the previous character, skipping over combining marks (they belong to the character before them)
+                int cp;
+
+                do E.buf->cx = editorRowCharStart(row, E.buf->cx - 1);
+                while (E.buf->cx > 0 && editorRowCharLen(row, E.buf->cx, &cp) && cp >= 0 && editorWidthClass(cp) == WC_ZERO);
             }
-            else if (E.cy > 0) 
+            else if (E.buf->cy > 0) 
             {
-                // move cursor up a line if left arrow is pressed at the beginning of a line (E.cx == 0)
-                E.cy--;
-                E.cx = E.row[E.cy].size;
+                // move cursor up a line if left arrow is pressed at the beginning of a line (E.buf->cx == 0)
+                E.buf->cy--;
+                E.buf->cx = editorRow(E.buf->cy)->size;
             }
             break;
         case ARROW_RIGHT:
-            if (row && E.cx < row->size) // limiting scrolling past the end of the current line
+            if (row && E.buf->cx < row->size) // limiting scrolling past the end of the current line
             {
-                E.cx++;
+                int cp;
+
+                E.buf->cx += editorRowCharLen(row, E.buf->cx, &cp);
+                while (E.buf->cx < row->size && editorRowCharLen(row, E.buf->cx, &cp) && cp >= 0 && editorWidthClass(cp) == WC_ZERO)
+                    E.buf->cx += editorRowCharLen(row, E.buf->cx, &cp);
             }
-            else if (row && E.cx == row->size) // if there is a row and E.cx is the row size (at the end of the line)
+            else if (row && E.buf->cx == row->size) // if there is a row and E.buf->cx is the row size (at the end of the line)
             {
-                E.cy++;
-                E.cx = 0;
+                E.buf->cy++;
+                E.buf->cx = 0;
             }
             break;
         case ARROW_UP:
-            if (E.cy != 0)
-                E.cy--;
-            break;
         case ARROW_DOWN:
-            if (E.cy < E.numrows)
-                E.cy++;
+            {
+                // stay in the same screen column, not at the same byte index (tabs, wide and multibyte characters)
+                long rx = row ? editorRowCxToRx(row, E.buf->cx) : E.buf->cx;
+
+                if (key == ARROW_UP && E.buf->cy != 0)
+                    E.buf->cy--;
+                else if (key == ARROW_DOWN && E.buf->cy < E.buf->numrows)
+                    E.buf->cy++;
+
+                if (E.buf->cy < E.buf->numrows)
+                    E.buf->cx = editorRowRxToCx(editorRow(E.buf->cy), rx);
+            }
             break;
     }
 
-    // set row again, since E.cy could point to a different line than it did before
-    // set E.cx to the end of that line if E.cx is to the right of the end of that line
-    row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
-    int rowlen = row ? row->size : 0;
+    // set row again, since E.buf->cy could point to a different line than it did before
+    // set E.buf->cx to the end of that line if E.buf->cx is to the right of the end of that line
+    row = (E.buf->cy >= E.buf->numrows) ? NULL : editorRow(E.buf->cy);
+    long rowlen = row ? row->size : 0;
 
-    if (E.cx > rowlen)
-        E.cx = rowlen;
+    if (E.buf->cx > rowlen)
+        E.buf->cx = rowlen;
 }
 
-// wait for keypress, then handle it. deals with mapping keys to editor functions at a much higher level
-void editorProcessKeypress() 
+// what a key does
+void editorProcessKey(int c)
 {
-    // We use a static variable in editorProcessKeypress() to keep track of how many more times the user must press Ctrl-Q to quit
+    // We use a static variable in editorProcessKey() to keep track of how many more times the user must press Ctrl-Q to quit
     static int quit_times = QUIT_TIMES;
+    static int save_times = SAVE_TIMES; // same for saving over a file another program changed
+    static int close_times = QUIT_TIMES; // and for closing a buffer with unsaved changes
 
-    int c = editorReadKey();
+    // -R: only moving around, searching and quitting
+    if (E.buf->readonly && (c == '\r' || c == BACKSPACE || c == CTRL_KEY('h') || c == DEL_KEY || c == CTRL_KEY('s') || (c >= 32 && c < ARROW_LEFT) || c == '\t'))
+    {
+        editorSetStatusMessage("Read-only (opened with -R)");
+        return;
+    }
+
+    if (E.buf->hexmode && editorHexKey(c))
+    {
+        quit_times = QUIT_TIMES;
+        save_times = SAVE_TIMES;
+        close_times = QUIT_TIMES;
+        return;
+    }
 
     switch (c) 
     {
@@ -883,49 +5575,96 @@ void editorProcessKeypress()
             break;
 
         case CTRL_KEY('q'):
-            if (E.dirty && quit_times > 0)
+            if (editorBuffersDirty() && quit_times > 0)
             {
-                editorSetStatusMessage("WARNING! File has unsaved changes. Press Ctrl-Q again to quit.");
+                if (E.buf->dirty)
+                    editorSetStatusMessage("WARNING! File has unsaved changes. Press Ctrl-Q again to quit.");
+                else
+                    editorSetStatusMessage("WARNING! Another buffer has unsaved changes (Ctrl-N/Ctrl-P). Ctrl-Q again quits.");
                 quit_times--; // When quit_times hits 0, the program to exits
 
                 return;
             }
-            write(STDOUT_FILENO, "\x1b[2J", 4);
-            write(STDOUT_FILENO, "\x1b[H", 3);
+            editorWriteAll(STDOUT_FILENO, "\x1b[2J\x1b[H", 7);
             exit(0);
             break;
 
         case CTRL_KEY('s'):
-            editorSave();
+            if (editorWatchChanged() && save_times > 0)
+            {
+                editorSetStatusMessage("WARNING! File changed on disk. Ctrl-S again overwrites it, Ctrl-R reloads it.");
+                save_times--;
+
+                return;
+            }
+
+            {
+                uint64_t t = editorTraceBegin();
+
+                editorSave();
+                editorTraceEnd(TRACE_SAVE, t);
+            }
+            break;
+
+        case CTRL_KEY('r'):
+            editorReload();
+            break;
+
+        case CTRL_KEY('o'):
+            editorBufferPrompt();
+            break;
+
+        case CTRL_KEY('n'):
+        case CTRL_KEY('p'):
+            editorBufferSwitch(c == CTRL_KEY('n') ? 1 : -1);
+            break;
+
+        case CTRL_KEY('w'):
+            if (E.buf->dirty && close_times > 0)
+            {
+                editorSetStatusMessage("WARNING! File has unsaved changes. Press Ctrl-W again to close it.");
+                close_times--;
+
+                return;
+            }
+            editorBufferClose();
+            break;
+
+        case CTRL_KEY('g'):
+            editorGoto();
+            break;
+
+        case CTRL_KEY('f'):
+            editorFind();
+            break;
+
+        case CTRL_KEY('u'):
+            editorShowMemory();
+            break;
+
+        case CTRL_KEY('t'):
+            E.stats.on = !E.stats.on; // the timing overlay
+            E.stats.key_time = 0;
+            E.stats.frames = 0;
+            E.stats.fps_time = editorNow();
             break;
 
         case HOME_KEY:
-            E.cx = 0;
+            E.buf->cx = 0;
             break;
         case END_KEY:
-            if (E.cy < E.numrows)
-                E.cx = E.row[E.cy].size;
+            if (E.buf->cy < E.buf->numrows)
+                E.buf->cx = editorRow(E.buf->cy)->size;
             break;
 
-        // move to either the beginning or the end of the screen
         case PAGE_UP:
         case PAGE_DOWN:
-            {
-                if (c == PAGE_UP)
-                {
-                    E.cy = E.rowoff;
-                } 
-                else if (c == PAGE_DOWN)
-                {
-                    E.cy = E.rowoff + E.screenrows - 1;
-                    if (E.cy > E.numrows) E.cy = E.numrows;
-                }
-
-                int times = E.screenrows; // how many times to move
+            editorPage(c == PAGE_UP ? -1 : 1);
+            break;
 
-                while (times--)
-                    editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
-            }
+        case FILE_START:
+        case FILE_END:
+            editorJumpToEnd(c == FILE_END);
             break;
 
         case ARROW_UP:
@@ -936,6 +5675,9 @@ void editorProcessKeypress()
             break;
 
         case CTRL_KEY('l'):
+            editorScreenInvalidate(); // draw everything again, whatever the terminal shows now
+            break;
+
         case '\x1b': // escape key
             break;
 
@@ -945,40 +5687,133 @@ void editorProcessKeypress()
     }
 
     quit_times = QUIT_TIMES;
+    save_times = SAVE_TIMES;
+    close_times = QUIT_TIMES;
+}
+
+// wait for keypress, then handle it. deals with mapping keys to editor functions at a much higher level
+void editorProcessKeypress() 
+{
+    int c = editorReadKey();
+    uint64_t t = editorTraceBegin();
+
+    editorProcessKey(c);
+    editorTraceEnd(TRACE_PROCESS_KEY, t);
+}
+
+// is there a key (or will there be one within 'wait' seconds)?
+int editorInputPending(double wait)
+{
+    struct pollfd in = { STDIN_FILENO, POLLIN, 0 };
+
+    if (wait < 0) wait = 0;
+    if (E.headless.on) return E.headless.pos < E.headless.len;
+    if (E.keys.pos < E.keys.count) return E.keys.due - editorNow() <= wait;
+    if (E.typeahead.pos < E.typeahead.len) return 1;
+
+    return poll(&in, 1, wait * 1000) > 0;
+}
+
+/*
+  Process a key, and every key after it that's already there: a paste, or keys that piled up while a frame was
+  being drawn, all go before the next frame instead of getting one each.
+  Keys that come in before the next frame is due (frame_interval after the last one) are taken too, so holding
+  a key down doesn't draw faster than FRAME_RATE. A key after a pause is drawn right away.
+*/
+void editorProcessInput()
+{
+    editorProcessKeypress();
+
+    while (editorInputPending(E.frame_time + E.frame_interval - editorNow()))
+        editorProcessKeypress();
 }
 
 /*** main ***/
 void initEditor() 
 {
-    E.cx = 0;
-    E.cy = 0;
-    E.rx = 0;
-    E.rowoff = 0;
-    E.coloff = 0;
-    E.numrows = 0;
-    E.dirty = 0;
-    E.row = NULL;
-    E.filename = NULL;
+    E.version_clock = 0;
+    editorBufferNew(); // an empty one, until a file is opened
+    editorBufferSelect(0);
     E.statusmsg[0] = '\0';
     E.statusmsg_time = 0;
+    editorSyntaxInit();
 
-    if (getWindowSize(&E.screenrows, &E.screencols) == -1) die("getWindowSize");
+    if (getenv("HEXA_TRACE")) editorTraceOpen(getenv("HEXA_TRACE"));
+
+    if (E.headless.on)
+    {
+        E.screenrows = E.headless.rows;
+        E.screencols = E.headless.cols;
+    }
+    else if (getWindowSize(&E.screenrows, &E.screencols) == -1)
+    {
+        die("getWindowSize");
+    }
     E.screenrows -= 2; // so that editorDrawRows() doesn’t try to draw a line of text at the bottom of the screen (- 2 for 2 rows)
 }
 
 int main(int argc, char* argv[]) 
 {
+    int opt, i;
+
+    E.keys.record = -1;
+    E.frame_interval = 1.0 / FRAME_RATE;
+
+    while ((opt = getopt(argc, argv, "Rfxr:p:F:")) != -1)
+    {
+        if (opt == 'R')
+        {
+            E.open_readonly = 1; // view huge files (see editorViewOpen())
+        }
+        else if (opt == 'f')
+        {
+            E.open_follow = 1; // follow a growing file (see editorWatchPoll())
+        }
+        else if (opt == 'x')
+        {
+            E.open_hexmode = 1; // binary files (see editorHexOpen())
+        }
+        else if (opt == 'r')
+        {
+            if (editorKeysRecordTo(optarg) == -1) // record what's typed
+            {
+                perror(optarg);
+                exit(1);
+            }
+        }
+        else if (opt == 'p')
+        {
+            if (editorKeysLoad(optarg) == -1) // play back what was recorded (see editorKeysPlay())
+            {
+                perror(optarg);
+                exit(1);
+            }
+        }
+        else if (opt == 'F')
+        {
+            int fps = atoi(optarg); // most frames a second (0: no limit)
+            E.frame_interval = (fps > 0) ? 1.0 / fps : 0;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: hexa [-R] [-f] [-x] [-r keys] [-p keys] [-F fps] [filename ...]\n");
+            exit(1);
+        }
+    }
+
     enableRawMode();
     initEditor();
-    if (argc >= 2)
-        editorOpen(argv[1]);
+    editorDetectSync();
+    for (i = optind; i < argc; i++)
+        editorBufferOpen(argv[i]);
+    editorBufferSelect(0); // the first one
 
-    editorSetStatusMessage("Help: Ctrl-S = save | Ctrl-Q = quit");
+    editorSetStatusMessage("Help: Ctrl-S = save | Ctrl-F = find | Ctrl-G = go to line | Ctrl-O = open | Ctrl-Q = quit");
 
     while (1) 
     {
         editorRefreshScreen();
-        editorProcessKeypress();
+        editorProcessInput();
     }
 
     return 0;
@@ -0,0 +1,381 @@
+// bench: drives the editor headless (no terminal) with scripted keystrokes and reports how long every operation took
+// usage: bench [-s ROWSxCOLS] [-n lines] [-f file] [script ...]   (defaults: 24x80, 100000 lines)
+// Every workload opens a file (a generated C-like one, or -f, e.g. from tools/corpus) and feeds keys to editorProcessKeypress(), redrawing after every key
+// like main() does. Scripts given as arguments are keys recorded with hexa -r (played back without waiting, up to a
+// Ctrl-Q) or files of bytes as the terminal sends them (which shouldn't press Ctrl-Q), one operation per key.
+// mem MB is what the buffer takes up after the workload (editorMemoryUsage()), broken down after the table.
+// Built with malloc() and friends wrapped (-Wl,--wrap, see the Makefile) to count the allocations the editor makes.
+#define main hexa_main
+#include "../hexa.c"
+#undef main
+
+/*** allocations ***/
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+void __real_free(void* p);
+
+long allocs; // malloc(), calloc() and realloc() calls, from any thread (the highlighter allocates too)
+
+void* __wrap_malloc(size_t size)
+{
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, size_t size)
+{
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void* p)
+{
+    __real_free(p);
+}
+
+
+/*** util ***/
+double now()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void fail(const char* what)
+{
+    perror(what);
+    exit(1);
+}
+
+// a growing string of keys
+struct keys
+{
+    char* b;
+    long len;
+    long cap;
+};
+
+void keysAdd(struct keys* k, const char* s, long len)
+{
+    if (k->len + len > k->cap)
+    {
+        k->cap = (k->len + len) * 2;
+        k->b = realloc(k->b, k->cap);
+        if (k->b == NULL) fail("realloc");
+    }
+
+    memcpy(&k->b[k->len], s, len);
+    k->len += len;
+}
+
+void keysRepeat(struct keys* k, const char* s, long times)
+{
+    while (times-- > 0) keysAdd(k, s, strlen(s));
+}
+
+void keysFree(struct keys* k)
+{
+    free(k->b);
+    memset(k, 0, sizeof(*k));
+}
+
+
+/*** corpus ***/
+// lines of something like C, the same every run
+void generate(const char* path, long lines)
+{
+    static const char* words[] = { "int", "return", "if", "while", "for", "char*", "long", "static", "struct", "else",
+        "erow", "row", "size", "len", "at", "E.buf->cy", "NULL", "0", "1", "// a comment", "\"string\"", "(", ")", "+", "=" };
+    FILE* fp = fopen(path, "w");
+    unsigned long seed = 1;
+    long n;
+
+    if (fp == NULL) fail(path);
+
+    for (n = 0; n < lines; n++)
+    {
+        int indent, count, i;
+
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        indent = (seed >> 33) % 4;
+        count = (seed >> 40) % 12;
+
+        for (i = 0; i < indent; i++) fputs("    ", fp);
+        for (i = 0; i < count; i++)
+        {
+            seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+            fprintf(fp, "%s%s", i ? " " : "", words[(seed >> 33) % (sizeof(words) / sizeof(words[0]))]);
+        }
+        fputs(count ? ";\n" : "\n", fp);
+    }
+
+    if (fclose(fp) != 0) fail(path);
+}
+
+
+/*** benchmark ***/
+struct result
+{
+    double* times; // of every operation, in seconds
+    long ops;
+    long cap;
+    long bytes; // sent to the (pretend) terminal
+    long allocs;
+    double total;
+};
+
+void resultAdd(struct result* r, double t)
+{
+    if (r->ops == r->cap)
+    {
+        r->cap = r->cap ? r->cap * 2 : 1024;
+        r->times = realloc(r->times, r->cap * sizeof(double));
+        if (r->times == NULL) fail("realloc");
+    }
+
+    r->times[r->ops++] = t;
+    r->total += t;
+}
+
+int compareTimes(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+double percentile(struct result* r, int p)
+{
+    long at = (r->ops - 1) * p / 100;
+    return r->ops ? r->times[at] * 1e6 : 0;
+}
+
+// a line of the table, with what the buffer takes up once the workload is done
+void report(const char* name, struct result* r)
+{
+    struct editorMemory m;
+
+    qsort(r->times, r->ops, sizeof(double), compareTimes);
+    editorMemoryUsage(&m);
+
+    printf("%-10s %7ld %9.1f %9.1f %9.1f %9.1f %10.1f %10ld %9.1f %8.1f\n", name, r->ops,
+        percentile(r, 50), percentile(r, 90), percentile(r, 99), percentile(r, 100), r->total * 1e3,
+        r->ops ? r->bytes / r->ops : 0, r->ops ? (double)r->allocs / r->ops : 0, m.total / (1024.0 * 1024));
+
+    free(r->times);
+    memset(r, 0, sizeof(*r));
+}
+
+// what main() does for keys: process one (burst: and all the ones queued after it), pick up highlighting that's done,
+// and draw the screen
+void step(int burst)
+{
+    if (burst)
+        editorProcessInput();
+    else
+        editorProcessKeypress();
+
+    editorSyntaxPoll();
+    editorRefreshScreen();
+}
+
+// the file, freshly opened, with the cursor at its top
+void reopen(const char* path)
+{
+    editorOpen((char*)path);
+    E.buf->cx = E.buf->cy = 0;
+    E.buf->rowoff = E.buf->coloff = 0;
+    E.buf->dirty = 0;
+    editorRefreshScreen();
+}
+
+// feed keys to the editor: every key is an operation (perkey, as if typed), or all of them together are one (arriving
+// at once, like a paste)
+void feed(struct result* r, const char* keys, long len, int perkey)
+{
+    long bytes = E.headless.bytes;
+    long before = allocs;
+    double t = now();
+
+    E.headless.keys = keys;
+    E.headless.len = len;
+    E.headless.pos = 0;
+
+    while (E.headless.pos < E.headless.len)
+    {
+        step(!perkey);
+
+        if (perkey)
+        {
+            double end = now();
+            resultAdd(r, end - t);
+            t = end;
+        }
+    }
+    if (!perkey) resultAdd(r, now() - t);
+
+    r->bytes += E.headless.bytes - bytes;
+    r->allocs += __atomic_load_n(&allocs, __ATOMIC_RELAXED) - before;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* path = "/tmp/hexa-bench.c";
+    char saved[4096];
+    long lines = 100000;
+    int generated = 1;
+    int rows = 24, cols = 80;
+    struct result r = { 0 };
+    struct keys k = { 0 };
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "s:n:f:")) != -1)
+    {
+        if (opt == 's' && sscanf(optarg, "%dx%d", &rows, &cols) == 2 && rows > 2 && cols > 0) continue;
+        if (opt == 'n' && (lines = atol(optarg)) > 0) continue;
+        if (opt == 'f')
+        {
+            path = optarg;
+            generated = 0;
+            continue;
+        }
+
+        fprintf(stderr, "Usage: bench [-s ROWSxCOLS] [-n lines] [-f file] [script ...]\n");
+        exit(1);
+    }
+
+    E.headless.on = 1;
+    E.headless.rows = rows;
+    E.headless.cols = cols;
+    initEditor();
+
+    if (generated) generate(path, lines);
+    snprintf(saved, sizeof(saved), "%s.saved", path); // the file itself stays as it is
+
+    reopen(path);
+    printf("%s: %ld lines on a %dx%d terminal\n", path, E.buf->numrows, rows, cols);
+    printf("%-10s %7s %9s %9s %9s %9s %10s %10s %9s %8s\n", "workload", "ops", "p50 us", "p90 us", "p99 us", "max us",
+        "total ms", "bytes/op", "allocs/op", "mem MB");
+
+    // open: reading the whole file and drawing its first screen
+    for (i = 0; i < 10; i++)
+    {
+        long bytes = E.headless.bytes;
+        long before = allocs;
+        double t = now();
+
+        reopen(path);
+        resultAdd(&r, now() - t);
+        r.bytes += E.headless.bytes - bytes;
+        r.allocs += __atomic_load_n(&allocs, __ATOMIC_RELAXED) - before;
+    }
+    report("open", &r);
+
+    // type: a line of code at a time, in the middle of the file
+    reopen(path);
+    E.buf->cy = E.buf->numrows / 2;
+    keysRepeat(&k, "    hexa = editorRow(at)->size;\r", 100);
+    feed(&r, k.b, k.len, 1);
+    report("type", &r);
+    keysFree(&k);
+
+    // scroll: line by line, then a screen at a time, down and back up
+    reopen(path);
+    keysRepeat(&k, "\x1b[B", 2000);
+    keysRepeat(&k, "\x1b[6~", 500);
+    keysRepeat(&k, "\x1b[5~", 500);
+    keysRepeat(&k, "\x1b[A", 2000);
+    feed(&r, k.b, k.len, 1);
+    report("scroll", &r);
+    keysFree(&k);
+
+    // paste: a burst of 4 KB arriving at once, measured until the screen after its last key is drawn
+    reopen(path);
+    E.buf->cy = E.buf->numrows / 2;
+    keysRepeat(&k, "static long pasted = 0; // some text that was copied\r", 4096 / 53);
+    for (i = 0; i < 20; i++) feed(&r, k.b, k.len, 0);
+    report("paste", &r);
+    keysFree(&k);
+
+    // search: a word found every few lines, and one that's nowhere
+    reopen(path);
+    keysRepeat(&k, "\x06" "while\r", 200);
+    keysRepeat(&k, "\x06" "nowhere\r", 5);
+    feed(&r, k.b, k.len, 1);
+    report("search", &r);
+    keysFree(&k);
+
+    // save: writing the whole file out (as another file)
+    reopen(path);
+    free(E.buf->filename);
+    E.buf->filename = strdup(saved);
+    keysRepeat(&k, "\x13", 10);
+    feed(&r, k.b, k.len, 1);
+    report("save", &r);
+    keysFree(&k);
+
+    // recorded scripts
+    for (i = optind; i < argc; i++)
+    {
+        FILE* fp = fopen(argv[i], "r");
+        char buf[4096];
+        char* late = NULL;
+        size_t n;
+        long j;
+
+        if (fp == NULL) fail(argv[i]);
+        if (fread(buf, 1, 8, fp) == 8 && !memcmp(buf, KEYS_MAGIC, 8))
+        {
+            // recorded with -r: the bytes, and which of them came on their own (see editorReadNext())
+            if (editorKeysLoad(argv[i]) == -1) fail(argv[i]);
+            late = malloc(E.keys.count + 1);
+            for (j = 0; j < E.keys.count && E.keys.replay[j].byte != CTRL_KEY('q'); j++) // up to the Ctrl-Q that ended it
+            {
+                keysAdd(&k, (char*)&E.keys.replay[j].byte, 1);
+                late[j] = (E.keys.replay[j].delay >= KEYS_ESCAPE_WAIT_US);
+            }
+            free(E.keys.replay); // copied into k: nothing is played back from it
+            E.keys.replay = NULL;
+            E.keys.count = 0;
+        }
+        else
+        {
+            rewind(fp);
+            while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) keysAdd(&k, buf, n);
+        }
+        fclose(fp);
+
+        reopen(path);
+        free(E.buf->filename);
+        E.buf->filename = strdup(saved); // a script that saves doesn't change the file
+        unlink(saved); // (and isn't asked to confirm saving over a file that changed)
+        E.headless.late = late;
+        feed(&r, k.b, k.len, 1);
+        E.headless.late = NULL;
+        report(strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i], &r);
+        keysFree(&k);
+        free(late);
+    }
+
+    // what the last buffer takes up, broken down
+    {
+        struct editorMemory m;
+
+        editorMemoryUsage(&m);
+        printf("mem %.1f MB: rows %.1f text %.1f hl %.1f rxmap %.1f view %.1f hex %.1f (peak frame %ld bytes, not counted)\n",
+            m.total / 1048576.0, m.nodes / 1048576.0, m.text / 1048576.0, m.hl / 1048576.0, m.rxmap / 1048576.0,
+            m.view / 1048576.0, m.hex / 1048576.0, m.frame_peak);
+    }
+
+    if (generated) unlink(path);
+    unlink(saved);
+    return 0;
+}
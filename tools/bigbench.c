@@ -0,0 +1,134 @@
+// bigbench: times opening and saving a file bigger than 4 GB (sizes past 32 bits all the way through the buffer and file IO)
+// usage: bigbench [size in MB] [line length] [path]   (defaults: 4300 MB, 80 byte lines, /tmp/hexa-bigbench.txt)
+// The file is generated, opened with editorOpen(), saved with editorSave() to path.out, and compared with the original.
+#define main hexa_main
+#include "../hexa.c"
+#undef main
+
+/*** util ***/
+double now()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// resident set size of this process, in MB
+long rssMB()
+{
+    FILE* fp = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = 0;
+
+    if (fp == NULL) return 0;
+    while (fgets(line, sizeof(line), fp))
+        if (!strncmp(line, "VmRSS:", 6)) kb = atol(&line[6]);
+
+    fclose(fp);
+    return kb / 1024;
+}
+
+void fail(const char* what)
+{
+    perror(what);
+    exit(1);
+}
+
+
+/*** benchmark ***/
+// write size bytes of lines of (about) linelen bytes, every one of them different
+void generate(const char* path, long size, long linelen)
+{
+    FILE* fp = fopen(path, "w");
+    char* line = malloc(linelen + 21); // room for the number, even in lines shorter than it
+    long written = 0;
+    long n = 0;
+    long i;
+
+    if (fp == NULL || line == NULL) fail(path);
+
+    for (i = 0; i < linelen - 1; i++) line[i] = 'a' + i % 26;
+    line[linelen - 1] = '\n';
+
+    while (written < size)
+    {
+        long len = (size - written < linelen) ? size - written : linelen;
+
+        snprintf(line, 21, "%020ld", n++); // numbered, so a line that ends up in the wrong place shows
+        line[20] = (linelen > 21) ? ' ' : '\n';
+        line[linelen - 1] = '\n'; // a line shorter than the number is cut, and only numbered in part
+        if (len < linelen) line[len - 1] = '\n';
+
+        if (fwrite(line, 1, len, fp) != (size_t)len) fail(path);
+        written += len;
+    }
+
+    free(line);
+    if (fclose(fp) != 0) fail(path);
+}
+
+// compare two files, a block at a time
+int same(const char* a, const char* b)
+{
+    FILE* fa = fopen(a, "r");
+    FILE* fb = fopen(b, "r");
+    static char ba[1 << 20], bb[1 << 20];
+    int ok = 1;
+
+    if (fa == NULL || fb == NULL) return 0;
+
+    while (ok)
+    {
+        size_t na = fread(ba, 1, sizeof(ba), fa);
+        size_t nb = fread(bb, 1, sizeof(bb), fb);
+
+        if (na != nb || memcmp(ba, bb, na)) ok = 0;
+        if (na == 0) break;
+    }
+
+    fclose(fa);
+    fclose(fb);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    long size = (argc > 1 ? atol(argv[1]) : 4300) * 1024 * 1024;
+    long linelen = (argc > 2) ? atol(argv[2]) : 80;
+    const char* path = (argc > 3) ? argv[3] : "/tmp/hexa-bigbench.txt";
+    char out[4096];
+    double t;
+
+    if (linelen < 2) linelen = 2;
+    snprintf(out, sizeof(out), "%s.out", path);
+
+    // no terminal, like tools/bench.c: initEditor() makes the empty buffer editorOpen() fills
+    E.headless.on = 1;
+    E.headless.rows = 24;
+    E.headless.cols = 80;
+    initEditor();
+
+    printf("generating %ld MB in lines of %ld bytes: %s\n", size >> 20, linelen, path);
+    generate(path, size, linelen);
+
+    t = now();
+    editorOpen((char*)path);
+    t = now() - t;
+    printf("open: %.2f s (%.0f MB/s), %ld rows, rss %ld MB\n", t, (size >> 20) / t, E.buf->numrows, rssMB());
+
+    free(E.buf->filename);
+    E.buf->filename = strdup(out);
+
+    t = now();
+    editorSave();
+    t = now() - t;
+    printf("save: %.2f s (%.0f MB/s): %s\n", t, (size >> 20) / t, E.statusmsg);
+
+    int ok = same(path, out);
+    printf("saved file %s the original\n", ok ? "matches" : "DOES NOT match");
+
+    unlink(path);
+    unlink(out);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+// corpus: writes a file of a given kind and size for benchmarks, the same one every time for the same seed
+// usage: corpus <kind> <size in MB> <seed> <path>
+// kinds: log (long lines of a server log), json (minified, all on one line), makefile (lines indented with tabs),
+//        crlf (text with DOS line endings), utf8 (mostly multi-byte and wide characters), binary (random bytes)
+// Files of any size (1 MB to 10 GB and more) are written a buffer at a time; a file ends where its size is reached,
+// so the last line (or JSON value) may be cut short.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** output ***/
+char buf[1 << 20];
+long buflen;
+long written; // to the file, and in buf
+long size; // what the file is to be
+FILE* fp;
+
+void fail(const char* what)
+{
+    perror(what);
+    exit(1);
+}
+
+void flush()
+{
+    if (fwrite(buf, 1, buflen, fp) != (size_t)buflen) fail("fwrite");
+    buflen = 0;
+}
+
+// append to the file, up to its size
+void out(const char* s, long len)
+{
+    if (len > size - written) len = size - written;
+
+    while (len > 0)
+    {
+        long n = (len < (long)sizeof(buf) - buflen) ? len : (long)sizeof(buf) - buflen;
+
+        memcpy(&buf[buflen], s, n);
+        buflen += n;
+        written += n;
+        s += n;
+        len -= n;
+
+        if (buflen == sizeof(buf)) flush();
+    }
+}
+
+void outs(const char* s)
+{
+    out(s, strlen(s));
+}
+
+// printf() to the file
+void outf(const char* fmt, ...)
+{
+    char s[1024];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int len = vsnprintf(s, sizeof(s), fmt, ap);
+    va_end(ap);
+
+    out(s, (len < (int)sizeof(s)) ? len : (int)sizeof(s) - 1);
+}
+
+
+/*** randomness ***/
+unsigned long long state;
+
+// splitmix64: good enough and the same everywhere
+unsigned long long next()
+{
+    unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// 0 to n - 1
+long pick(long n)
+{
+    return next() % n;
+}
+
+#define PICK(a) (a[pick(sizeof(a) / sizeof(a[0]))])
+
+const char* words[] = { "request", "buffer", "row", "cursor", "render", "screen", "file", "line", "offset", "cache",
+    "worker", "thread", "socket", "timeout", "session", "user", "query", "index", "page", "token" };
+
+
+/*** kinds ***/
+void genLog()
+{
+    static const char* levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+    long n = 0;
+
+    while (written < size)
+    {
+        int i, fields = 4 + pick(20);
+
+        outf("2024-%02ld-%02ldT%02ld:%02ld:%02ld.%06ldZ %-5s [%s-%ld] %s %s", 1 + pick(12), 1 + pick(28), pick(24),
+            pick(60), pick(60), pick(1000000), PICK(levels), PICK(words), pick(64), PICK(words), PICK(words));
+        for (i = 0; i < fields; i++)
+            outf(" %s=%s%ld", PICK(words), PICK(words), pick(100000));
+        outf(" seq=%ld\n", n++);
+    }
+}
+
+void genJson()
+{
+    long n = 0;
+
+    outs("[");
+    while (written < size)
+    {
+        int i, fields = 2 + pick(8);
+
+        outf("%s{\"id\":%ld,\"name\":\"%s %s\",\"active\":%s,\"score\":%ld.%02ld,\"tags\":[", n ? "," : "", n,
+            PICK(words), PICK(words), pick(2) ? "true" : "false", pick(1000), pick(100));
+        for (i = 0; i < fields; i++) outf("%s\"%s\"", i ? "," : "", PICK(words));
+        outf("],\"nested\":{\"%s\":{\"%s\":%ld,\"list\":[%ld,%ld,%ld]}}}", PICK(words), PICK(words), pick(1 << 20),
+            pick(100), pick(100), pick(100));
+        n++;
+    }
+    outs("]"); // (when there's room)
+}
+
+void genMakefile()
+{
+    long n = 0;
+
+    while (written < size)
+    {
+        int i, lines = 1 + pick(6);
+
+        outf("%s_%ld: %s_%ld.o %s.o\n", PICK(words), n, PICK(words), n, PICK(words));
+        for (i = 0; i < lines; i++)
+        {
+            int depth = 1 + pick(3);
+
+            while (depth--) outs("\t");
+            outf("$(CC) $(CFLAGS) -c %s.c -o %s.o\t# %s\t%s\n", PICK(words), PICK(words), PICK(words), PICK(words));
+        }
+        outs("\n");
+        n++;
+    }
+}
+
+void genCrlf()
+{
+    while (written < size)
+    {
+        int i, count = pick(16);
+
+        for (i = 0; i < count; i++) outf("%s%s", i ? " " : "", PICK(words));
+        outs("\r\n");
+    }
+}
+
+void genUtf8()
+{
+    // accented Latin, Greek, Cyrillic, CJK (2 columns wide), emoji (wide, 4 bytes), and a combining accent
+    static const char* chars[] = { "é", "ü", "ñ", "ø", "λ", "Ω", "ж", "я", "中", "文", "字", "日", "本", "語", "한",
+        "글", "😀", "🚀", "🎉", "e\xcc\x81", "a", "b", " " };
+
+    while (written < size)
+    {
+        int i, count = pick(80);
+
+        for (i = 0; i < count; i++) outs(PICK(chars));
+        outs("\n");
+    }
+}
+
+void genBinary()
+{
+    unsigned char block[4096];
+    int i;
+
+    while (written < size)
+    {
+        if (pick(4) == 0)
+        {
+            memset(block, 0, sizeof(block)); // runs of zeros, like in most binaries
+        }
+        else
+        {
+            for (i = 0; i < (int)sizeof(block); i += 8)
+            {
+                unsigned long long r = next();
+                memcpy(&block[i], &r, 8);
+            }
+        }
+        out((char*)block, sizeof(block));
+    }
+}
+
+struct kind
+{
+    const char* name;
+    void (*generate)();
+};
+
+struct kind kinds[] = {
+    { "log", genLog },
+    { "json", genJson },
+    { "makefile", genMakefile },
+    { "crlf", genCrlf },
+    { "utf8", genUtf8 },
+    { "binary", genBinary },
+};
+
+int main(int argc, char* argv[])
+{
+    unsigned int i;
+
+    if (argc != 5)
+    {
+        fprintf(stderr, "Usage: corpus <log|json|makefile|crlf|utf8|binary> <size in MB> <seed> <path>\n");
+        return 1;
+    }
+
+    size = atol(argv[2]) * 1024 * 1024;
+    state = strtoull(argv[3], NULL, 0);
+
+    for (i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+    {
+        if (strcmp(argv[1], kinds[i].name)) continue;
+
+        fp = fopen(argv[4], "w");
+        if (fp == NULL) fail(argv[4]);
+
+        kinds[i].generate();
+        flush();
+
+        if (fclose(fp) != 0) fail(argv[4]);
+        return 0;
+    }
+
+    fprintf(stderr, "corpus: unknown kind '%s'\n", argv[1]);
+    return 1;
+}
@@ -0,0 +1,386 @@
+// syntaxgen: compiles syntax.def into syntax.h (the HLDB table hexa.c includes)
+// usage: syntaxgen syntax.def > syntax.h
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** defines ***/
+#define MAX_FILETYPES 32
+#define MAX_MATCHES 16
+#define MAX_KEYWORDS 512
+#define MAX_SEEDS 100000 // seeds to try before growing a keyword table
+
+// same bits as enum editorCharClass in hexa.c
+enum charClass
+{
+    CC_SEPARATOR = 1 << 0,
+    CC_WORD = 1 << 1,
+    CC_DIGIT = 1 << 2,
+    CC_NUMBER_DOT = 1 << 3,
+    CC_QUOTE = 1 << 4,
+    CC_COMMENT = 1 << 5,
+    CC_COMMENT_END = 1 << 6
+};
+
+const char* CLASS_NAMES[] = {
+    "CC_SEPARATOR", "CC_WORD", "CC_DIGIT", "CC_NUMBER_DOT", "CC_QUOTE", "CC_COMMENT", "CC_COMMENT_END"
+};
+
+
+/*** data ***/
+struct keyword
+{
+    char* word;
+    int type2; // HL_KEYWORD2 instead of HL_KEYWORD1
+};
+
+struct filetype
+{
+    char* name;
+    char* match[MAX_MATCHES];
+    int nmatch;
+    char* separators;
+    char* scs; // single line comment start
+    char* mcs; // multi line comment start
+    char* mce; // multi line comment end
+    int strings;
+    int numbers;
+    struct keyword keywords[MAX_KEYWORDS];
+    int nkeywords;
+};
+
+struct filetype FT[MAX_FILETYPES];
+int numft = 0;
+int lineno = 0;
+
+
+/*** util ***/
+void die(const char* fmt, const char* arg)
+{
+    fprintf(stderr, "syntaxgen: line %d: ", lineno);
+    fprintf(stderr, fmt, arg);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+char* xstrdup(const char* s)
+{
+    char* d = strdup(s);
+    if (d == NULL) die("%s", "out of memory");
+    return d;
+}
+
+// must produce the same values as editorKeywordHash() in hexa.c (FNV-1a from a seed, plus a final mix)
+unsigned int keywordHash(const char* s, int len, unsigned int seed)
+{
+    unsigned int h = 2166136261u ^ seed;
+    int i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+
+    // the low bits only depend on the low bits of the seed so far, mix the high bits down
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+
+    return h;
+}
+
+
+/*** parsing ***/
+struct filetype* current()
+{
+    if (numft == 0) die("%s", "expected 'filetype' first");
+    return &FT[numft - 1];
+}
+
+void parseLine(char* line)
+{
+    char* directive = strtok(line, " \t\r\n");
+    char* arg;
+
+    if (directive == NULL || directive[0] == '#') return;
+
+    if (!strcmp(directive, "filetype"))
+    {
+        if (numft == MAX_FILETYPES) die("%s", "too many filetypes");
+        if ((arg = strtok(NULL, " \t\r\n")) == NULL) die("%s", "filetype needs a name");
+
+        struct filetype* ft = &FT[numft++];
+        memset(ft, 0, sizeof(*ft));
+        ft->name = xstrdup(arg);
+        ft->separators = xstrdup(",.()+-/*=~%<>[];"); // kilo's default
+    }
+    else if (!strcmp(directive, "match"))
+    {
+        struct filetype* ft = current();
+        while ((arg = strtok(NULL, " \t\r\n")))
+        {
+            if (ft->nmatch == MAX_MATCHES - 1) die("%s", "too many patterns");
+            ft->match[ft->nmatch++] = xstrdup(arg);
+        }
+    }
+    else if (!strcmp(directive, "separators"))
+    {
+        if ((arg = strtok(NULL, " \t\r\n")) == NULL) die("%s", "separators needs a list of characters");
+        free(current()->separators);
+        current()->separators = xstrdup(arg);
+    }
+    else if (!strcmp(directive, "comment"))
+    {
+        if ((arg = strtok(NULL, " \t\r\n")) == NULL) die("%s", "comment needs a delimiter");
+        current()->scs = xstrdup(arg);
+    }
+    else if (!strcmp(directive, "block"))
+    {
+        char* end;
+        if ((arg = strtok(NULL, " \t\r\n")) == NULL || (end = strtok(NULL, " \t\r\n")) == NULL)
+            die("%s", "block needs a start and an end delimiter");
+        current()->mcs = xstrdup(arg);
+        current()->mce = xstrdup(end);
+    }
+    else if (!strcmp(directive, "strings"))
+    {
+        current()->strings = 1;
+    }
+    else if (!strcmp(directive, "numbers"))
+    {
+        current()->numbers = 1;
+    }
+    else if (!strcmp(directive, "keywords") || !strcmp(directive, "types"))
+    {
+        struct filetype* ft = current();
+        while ((arg = strtok(NULL, " \t\r\n")))
+        {
+            if (ft->nkeywords == MAX_KEYWORDS) die("%s", "too many keywords");
+            ft->keywords[ft->nkeywords].word = xstrdup(arg);
+            ft->keywords[ft->nkeywords].type2 = (directive[0] == 't');
+            ft->nkeywords++;
+        }
+    }
+    else
+    {
+        die("unknown directive '%s'", directive);
+    }
+}
+
+
+/*** tables ***/
+// the class of each byte, for a filetype
+void buildClasses(struct filetype* ft, unsigned char* classes)
+{
+    int c;
+
+    for (c = 0; c < 256; c++)
+    {
+        unsigned char k = 0;
+
+        if (c == '\0' || isspace(c) || (strchr(ft->separators, c) != NULL)) k |= CC_SEPARATOR;
+        else if (isalnum(c) || c == '_' || c >= 0x80) k |= CC_WORD;
+
+        if (ft->numbers && isdigit(c)) k |= CC_DIGIT;
+        if (ft->numbers && c == '.') k |= CC_NUMBER_DOT;
+        if (ft->strings && (c == '"' || c == '\'')) k |= CC_QUOTE;
+        if ((ft->scs && (unsigned char)ft->scs[0] == c) || (ft->mcs && (unsigned char)ft->mcs[0] == c)) k |= CC_COMMENT;
+        if (ft->mce && (unsigned char)ft->mce[0] == c) k |= CC_COMMENT_END;
+
+        classes[c] = k;
+    }
+}
+
+/*
+  Find a seed for which every keyword lands in its own slot of a power of two sized table.
+  The table starts at twice the number of keywords (rounded up) and doubles whenever no seed works.
+  Fills in slots[] with the index of the keyword in each slot (-1 for empty ones).
+*/
+void buildKeywordTable(struct filetype* ft, int* slots, unsigned int* size, unsigned int* seed)
+{
+    unsigned int n = 1;
+    while (n < (unsigned int)ft->nkeywords * 2) n <<= 1;
+
+    for (; n <= 1u << 16; n <<= 1)
+    {
+        unsigned int s;
+
+        for (s = 0; s < MAX_SEEDS; s++)
+        {
+            unsigned int i;
+            int j;
+
+            for (i = 0; i < n; i++) slots[i] = -1;
+
+            for (j = 0; j < ft->nkeywords; j++)
+            {
+                char* w = ft->keywords[j].word;
+                unsigned int h = keywordHash(w, strlen(w), s) & (n - 1);
+
+                if (slots[h] != -1) break;
+                slots[h] = j;
+            }
+
+            if (j == ft->nkeywords)
+            {
+                *size = n;
+                *seed = s;
+                return;
+            }
+        }
+    }
+
+    die("no perfect hash found for '%s'", ft->name);
+}
+
+
+/*** output ***/
+void printString(const char* s)
+{
+    if (s == NULL)
+    {
+        printf("NULL");
+        return;
+    }
+
+    putchar('"');
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\') putchar('\\');
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+void printClasses(unsigned char k)
+{
+    int bit, first = 1;
+
+    if (k == 0)
+    {
+        printf("0");
+        return;
+    }
+
+    for (bit = 0; bit < 7; bit++)
+    {
+        if (!(k & (1 << bit))) continue;
+        printf("%s%s", first ? "" : " | ", CLASS_NAMES[bit]);
+        first = 0;
+    }
+}
+
+void emitFiletype(struct filetype* ft, unsigned int* seed, unsigned int* size, int* minlen, int* maxlen)
+{
+    unsigned char classes[256];
+    static int slots[1 << 16];
+    unsigned int i;
+    int j;
+
+    printf("/* %s */\n", ft->name);
+
+    printf("char* HL_%s_filematch[] = { ", ft->name);
+    for (j = 0; j < ft->nmatch; j++)
+    {
+        printString(ft->match[j]);
+        printf(", ");
+    }
+    printf("NULL };\n\n");
+
+    buildClasses(ft, classes);
+    printf("const unsigned char HL_%s_classes[256] = {\n", ft->name);
+    for (i = 0; i < 256; i++)
+    {
+        if (classes[i] == 0) continue;
+        printf("    [%u] = ", i);
+        printClasses(classes[i]);
+        printf(",\n");
+    }
+    printf("};\n\n");
+
+    *minlen = 0;
+    *maxlen = 0;
+    for (j = 0; j < ft->nkeywords; j++)
+    {
+        int len = strlen(ft->keywords[j].word);
+        if (*minlen == 0 || len < *minlen) *minlen = len;
+        if (len > *maxlen) *maxlen = len;
+    }
+
+    buildKeywordTable(ft, slots, size, seed);
+    printf("const struct hlKeyword HL_%s_keywords[%u] = {\n", ft->name, *size);
+    if (ft->nkeywords == 0) printf("    { NULL, 0, 0 },\n"); // C doesn't allow empty initializers
+    for (i = 0; i < *size; i++)
+    {
+        if (slots[i] == -1) continue;
+
+        struct keyword* kw = &ft->keywords[slots[i]];
+        printf("    [%u] = { ", i);
+        printString(kw->word);
+        printf(", %d, %s },\n", (int)strlen(kw->word), kw->type2 ? "HL_KEYWORD2" : "HL_KEYWORD1");
+    }
+    printf("};\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: syntaxgen syntax.def > syntax.h\n");
+        return 1;
+    }
+
+    FILE* fp = fopen(argv[1], "r");
+    if (!fp)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    char* line = NULL;
+    size_t linecap = 0;
+
+    while (getline(&line, &linecap, fp) != -1)
+    {
+        lineno++;
+        parseLine(line);
+    }
+
+    free(line);
+    fclose(fp);
+
+    unsigned int seeds[MAX_FILETYPES], sizes[MAX_FILETYPES];
+    int minlens[MAX_FILETYPES], maxlens[MAX_FILETYPES];
+    int i;
+
+    printf("/* generated by tools/syntaxgen from %s, do not edit */\n\n", argv[1]);
+
+    for (i = 0; i < numft; i++)
+        emitFiletype(&FT[i], &seeds[i], &sizes[i], &minlens[i], &maxlens[i]);
+
+    printf("struct editorSyntax HLDB[] = {\n");
+    for (i = 0; i < numft; i++)
+    {
+        struct filetype* ft = &FT[i];
+
+        printf("    {\n        ");
+        printString(ft->name);
+        printf(",\n        HL_%s_filematch,\n        HL_%s_classes,\n", ft->name, ft->name);
+        printf("        HL_%s_keywords, %uu, %uu, %d, %d,\n", ft->name, seeds[i], sizes[i] - 1, minlens[i], maxlens[i]);
+        printf("        ");
+        printString(ft->scs);
+        printf(", ");
+        printString(ft->mcs);
+        printf(", ");
+        printString(ft->mce);
+        printf(",\n        %d, %d, %d\n    },\n", ft->scs ? (int)strlen(ft->scs) : 0, ft->mcs ? (int)strlen(ft->mcs) : 0, ft->mce ? (int)strlen(ft->mce) : 0);
+    }
+    printf("};\n");
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+// trace2json: turns a trace written with HEXA_TRACE=path into Chrome trace JSON (chrome://tracing, Perfetto)
+// usage: trace2json <trace> > trace.json
+// Spans are in the order they ended (a span ends after the ones inside it), times in microseconds from the first start.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../trace.h"
+
+const char* spanNames[TRACE_SPANS] = {
+    [TRACE_READ_KEY] = "read key",
+    [TRACE_PROCESS_KEY] = "process key",
+    [TRACE_UPDATE_ROW] = "update row",
+    [TRACE_RENDER] = "render",
+    [TRACE_WRITE] = "write",
+    [TRACE_SAVE] = "save",
+};
+
+int main(int argc, char* argv[])
+{
+    struct traceHeader header;
+    struct traceEvent* events;
+    uint64_t count, first, base, i;
+    FILE* fp;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: trace2json <trace>\n");
+        return 1;
+    }
+
+    fp = fopen(argv[1], "r");
+    if (fp == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic))
+        || header.capacity == 0)
+    {
+        fprintf(stderr, "trace2json: %s isn't a hexa trace\n", argv[1]);
+        return 1;
+    }
+
+    events = malloc(header.capacity * sizeof(struct traceEvent));
+    if (events == NULL || fread(events, sizeof(struct traceEvent), header.capacity, fp) != header.capacity)
+    {
+        fprintf(stderr, "trace2json: %s is cut short\n", argv[1]);
+        return 1;
+    }
+    fclose(fp);
+
+    // when the ring has wrapped around, the oldest span is the one the next would overwrite
+    count = (header.next < header.capacity) ? header.next : header.capacity;
+    first = header.next - count;
+
+    for (base = UINT64_MAX, i = 0; i < count; i++)
+        if (events[i].start < base) base = events[i].start;
+
+    printf("{\"traceEvents\":[\n");
+    for (i = 0; i < count; i++)
+    {
+        struct traceEvent* ev = &events[(first + i) % header.capacity];
+        const char* name = (ev->span < TRACE_SPANS && spanNames[ev->span]) ? spanNames[ev->span] : "unknown";
+
+        printf("%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}\n", i ? "," : "", name,
+            (ev->start - base) / 1e3, ev->duration / 1e3);
+    }
+    printf("],\"displayTimeUnit\":\"ms\"}\n");
+
+    free(events);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// wcwidthgen: generates wcwidth.h, the two-level display width table hexa.c uses for UTF-8 text
+// usage: wcwidthgen > wcwidth.h
+#define _XOPEN_SOURCE 700
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+/*** defines ***/
+#define MAX_CODEPOINT 0x110000
+#define BLOCK_BITS 8 // codepoints per block = 1 << BLOCK_BITS
+#define BLOCK_SIZE (1 << BLOCK_BITS)
+#define BLOCK_BYTES (BLOCK_SIZE / 4) // 2 bits per codepoint
+#define NUM_BLOCKS (MAX_CODEPOINT >> BLOCK_BITS)
+
+// the 2 bit values stored per codepoint (same as enum editorWidthClass in hexa.c)
+enum widthClass
+{
+    WC_ZERO = 0, // combining marks and other zero width characters
+    WC_NARROW = 1,
+    WC_WIDE = 2, // CJK, emoji, ... (2 columns)
+    WC_NONPRINT = 3 // control characters, unassigned codepoints, surrogates
+};
+
+
+/*** data ***/
+unsigned char blocks[NUM_BLOCKS][BLOCK_BYTES]; // unique blocks (first numunique are used)
+int numunique = 0;
+int stage1[NUM_BLOCKS]; // block number for every codepoint >> BLOCK_BITS
+
+
+/*** table ***/
+int widthClass(unsigned int cp)
+{
+    if (cp >= 0xD800 && cp <= 0xDFFF) return WC_NONPRINT;
+
+    switch (wcwidth((wchar_t)cp))
+    {
+        case 0: return WC_ZERO;
+        case 1: return WC_NARROW;
+        case 2: return WC_WIDE;
+        default: return WC_NONPRINT;
+    }
+}
+
+/*
+  Most blocks of 256 codepoints are identical (all narrow, all wide, all unassigned...),
+  so every block is only stored once and stage1 points at it.
+*/
+void buildTable()
+{
+    unsigned int b;
+
+    for (b = 0; b < NUM_BLOCKS; b++)
+    {
+        unsigned char block[BLOCK_BYTES];
+        unsigned int i;
+        int j;
+
+        memset(block, 0, sizeof(block));
+        for (i = 0; i < BLOCK_SIZE; i++)
+            block[i / 4] |= widthClass((b << BLOCK_BITS) | i) << ((i % 4) * 2);
+
+        for (j = 0; j < numunique; j++)
+            if (!memcmp(blocks[j], block, BLOCK_BYTES)) break;
+
+        if (j == numunique) memcpy(blocks[numunique++], block, BLOCK_BYTES);
+        stage1[b] = j;
+    }
+}
+
+
+/*** output ***/
+int main()
+{
+    unsigned int b;
+    int j, i;
+
+    if (setlocale(LC_CTYPE, "C.UTF-8") == NULL && setlocale(LC_CTYPE, "en_US.UTF-8") == NULL)
+    {
+        fprintf(stderr, "wcwidthgen: no UTF-8 locale available\n");
+        return 1;
+    }
+
+    buildTable();
+
+    if (numunique > 256)
+    {
+        fprintf(stderr, "wcwidthgen: %d unique blocks don't fit in a byte index\n", numunique);
+        return 1;
+    }
+
+    printf("/* generated by tools/wcwidthgen from the C library's wcwidth(), do not edit */\n");
+    printf("/* %d blocks of %d codepoints, %d bytes in total */\n\n", numunique, BLOCK_SIZE, NUM_BLOCKS + numunique * BLOCK_BYTES);
+    printf("#define WCW_BLOCK_BITS %d\n\n", BLOCK_BITS);
+
+    printf("const unsigned char WCW_STAGE1[%d] = {", NUM_BLOCKS);
+    for (b = 0; b < NUM_BLOCKS; b++)
+        printf("%s%d,", (b % 24 == 0) ? "\n    " : " ", stage1[b]);
+    printf("\n};\n\n");
+
+    printf("const unsigned char WCW_BLOCKS[%d][%d] = {\n", numunique, BLOCK_BYTES);
+    for (j = 0; j < numunique; j++)
+    {
+        printf("    {");
+        for (i = 0; i < BLOCK_BYTES; i++)
+            printf("%s0x%02x,", (i % 16 == 0) ? "\n        " : " ", blocks[j][i]);
+        printf("\n    },\n");
+    }
+    printf("};\n");
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+/* the trace file HEXA_TRACE=path writes, shared by hexa.c and tools/trace2json.c */
+#ifndef HEXA_TRACE_H
+#define HEXA_TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "HEXATRC1"
+
+// what a span of a trace timed
+enum traceSpan
+{
+    TRACE_READ_KEY = 1, // decoding a key (not waiting for it)
+    TRACE_PROCESS_KEY,
+    TRACE_UPDATE_ROW,
+    TRACE_RENDER, // editorRefreshScreen()
+    TRACE_WRITE, // of a frame to the terminal
+    TRACE_SAVE,
+    TRACE_SPANS
+};
+
+// spans are written to a ring buffer in the file (mapped, so it's there even after a crash).
+// The file is a traceHeader followed by 'capacity' traceEvents.
+struct traceHeader
+{
+    char magic[8]; // TRACE_MAGIC
+    uint64_t capacity;
+    uint64_t next; // spans ever written: the next one goes to events[next % capacity]
+};
+
+struct traceEvent
+{
+    uint64_t start; // CLOCK_MONOTONIC, in ns
+    uint32_t duration; // in ns
+    uint16_t span; // enum traceSpan
+    uint16_t unused;
+};
+
+#endif